@@ -26,12 +26,15 @@
 #include <QSqlError>
 #include <QSqlQuery>
 #include <QStandardPaths>
+#include <QTextStream>
 #include <QtNetwork/QLocalServer>
 #include <QtNetwork/QLocalSocket>
 #include <csignal>
 #include "mainwindow.h"
 #include "hotkeymanager.h"
 #include "extensionmanager.h"
+#include "persistencethread.h"
+#include "query.h"
 #include "querymanager.h"
 #include "settingswidget.h"
 #include "trayicon.h"
@@ -41,6 +44,7 @@ void myMessageOutput(QtMsgType type, const QMessageLogContext &context, const QS
 void shutdownHandler(int);
 void dispatchMessage();
 
+static const int               SCHEMA_VERSION = 1;
 
 static QApplication           *app;
 static QueryManager           *queryManager;
@@ -80,7 +84,7 @@ int main(int argc, char **argv) {
         parser.addVersionOption();
         parser.addOption(QCommandLineOption({"k", "hotkey"}, "Overwrite the hotkey to use.", "hotkey"));
         parser.addOption(QCommandLineOption({"p", "plugin-dirs"}, "Set the plugin dirs to use. Comma separated.", "directory"));
-        parser.addPositionalArgument("command", "Command to send to a running instance, if any. (show, hide, toggle)", "[command]");
+        parser.addPositionalArgument("command", "Command to send to a running instance, if any. (show, hide, toggle, latency)", "[command]");
         parser.process(*app);
 
 
@@ -98,7 +102,7 @@ int main(int argc, char **argv) {
                 socket.flush();
                 socket.waitForReadyRead(500);
                 if (socket.bytesAvailable())
-                    qDebug() << socket.readAll();
+                    QTextStream(stdout) << socket.readAll() << endl;
             }
             else
                 qDebug("There is another instance of albert running.");
@@ -203,15 +207,32 @@ int main(int argc, char **argv) {
                     ");"))
             qFatal("Unable to create table 'runtimes': %s", q.lastError().text().toUtf8().constData());
 
-        // Do regular cleanup
-        if (!q.exec("DELETE FROM usages WHERE julianday('now')-julianday(timestamp)>90;"))
-            qWarning("Unable to cleanup usages table.");
+        // Migrate the schema
+        int schemaVersion = 0;
+        if (q.exec("PRAGMA user_version;") && q.next())
+            schemaVersion = q.value(0).toInt();
+
+        if (schemaVersion < 1) {
+            // Covers the history (GROUP BY input ORDER BY max(timestamp)) and the retention deletes
+            if (!q.exec("CREATE INDEX IF NOT EXISTS usages_input_timestamp ON usages (input, timestamp);")
+                    || !q.exec("CREATE INDEX IF NOT EXISTS usages_timestamp ON usages (timestamp);")
+                    || !q.exec("CREATE INDEX IF NOT EXISTS runtimes_timestamp ON runtimes (timestamp);"))
+                qFatal("Unable to create indexes: %s", q.lastError().text().toUtf8().constData());
+        }
 
-        if (!q.exec("DELETE FROM runtimes WHERE julianday('now')-julianday(timestamp)>7;"))
-            qWarning("Unable to cleanup runtimes table.");
+        if (schemaVersion != SCHEMA_VERSION
+                && !q.exec(QString("PRAGMA user_version=%1;").arg(SCHEMA_VERSION)))
+            qFatal("Unable to set the schema version: %s", q.lastError().text().toUtf8().constData());
 
         db.commit();
 
+        // Writers do not block readers in WAL mode (persistent per database)
+        if (!q.exec("PRAGMA journal_mode=WAL;"))
+            qWarning("Unable to enable write-ahead logging.");
+
+        // All further writes and the regular cleanup go through the persistence thread
+        Core::PersistenceThread::instance()->open(db.databaseName());
+
 
         /*
          *  INITIALIZE APPLICATION COMPONENTS
@@ -381,6 +402,9 @@ int main(int argc, char **argv) {
     delete mainWindow;
     delete ExtensionManager::instance;
 
+    // Flush the pending database writes
+    Core::PersistenceThread::instance()->shutdown();
+
     // Delete the running indicator file
     QFile::remove(QStandardPaths::writableLocation(QStandardPaths::CacheLocation)+"/running");
 
@@ -436,6 +460,13 @@ void dispatchMessage() {
         } else if ( msg == "toggle") {
             mainWindow->toggleVisibility();
             socket->write("Visibility toggled.");
+        } else if ( msg == "latency") {
+            socket->write(QString("%1\nHidden %2 microseconds after the last activation, "
+                                  "its action started %3 microseconds after the activation and took %4 microseconds")
+                          .arg(mainWindow->showLatency())
+                          .arg(mainWindow->hideLatency())
+                          .arg(Core::Query::activationDelay())
+                          .arg(Core::Query::activationTime()).toLocal8Bit());
         } else
             socket->write("Command not supported.");
     }
@@ -14,63 +14,158 @@
 // You should have received a copy of the GNU General Public License
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
+#include <QDebug>
+#include <QHash>
+#include <QSqlDatabase>
 #include <QSqlQuery>
-#include <QSqlRecord>
 #include <QStringList>
 #include <QVariant>
+#include <QtConcurrent>
 #include "history.h"
 
+namespace {
+
+const size_t MAX_LINES = 1000;
+const char* CONNECTION_NAME = "history";
+
+QStringList loadHistory(const QString &databaseName) {
+    QStringList lines;
+    {
+        QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", CONNECTION_NAME);
+        db.setDatabaseName(databaseName);
+        if (db.open()) {
+            QSqlQuery query(db);
+            query.exec(QString("SELECT input FROM usages GROUP BY input ORDER BY max(timestamp) DESC LIMIT %1").arg(MAX_LINES));
+            while (query.next())
+                lines.append(query.value(0).toString());
+        } else
+            qWarning() << "Could not load the history.";
+    }
+    QSqlDatabase::removeDatabase(CONNECTION_NAME);
+    return lines;
+}
+
+}
+
+
+/** ***************************************************************************/
+History::History(QObject *parent)
+    : QObject(parent), head_(nullptr), tail_(nullptr), current_(nullptr) {
+    connect(&loader_, &QFutureWatcher<QStringList>::finished, this, &History::onLoaded);
+    loader_.setFuture(QtConcurrent::run(loadHistory, QSqlDatabase::database().databaseName()));
+}
+
 
-History::History(QObject *parent) : QObject(parent) {
-    currentLine_ = -1; // This means historymode is not active
+/** ***************************************************************************/
+History::~History() {
+    loader_.waitForFinished();
+}
+
+
+/** ***************************************************************************/
+size_t History::Hash::operator()(const QString &str) const {
+    return qHash(str);
 }
 
 
 /** ***************************************************************************/
 void History::add(QString str) {
-    if (!str.isEmpty()){
-        if (lines_.contains(str))
-            lines_.removeAll(str); // Remove dups
-        lines_.prepend(str);
+    if (str.isEmpty())
+        return;
+
+    // Move dups to the front
+    auto it = lines_.find(str);
+    if (it != lines_.end()) {
+        unlink(&it->second);
+        pushFront(&it->second);
+        return;
     }
+
+    it = lines_.emplace(str, Node()).first;
+    it->second.line = &it->first;
+    pushFront(&it->second);
+    if (lines_.size() > MAX_LINES)
+        evict();
 }
 
 
 /** ***************************************************************************/
 QString History::next() {
-    // Update the history at the beginnig
-    if (currentLine_ == -1)
-        updateHistory();
-
-    if (currentLine_+1 < static_cast<int>(lines_.size())
-            && static_cast<int>(lines_.size())!=0 ) {
-        ++currentLine_;
-        return lines_[currentLine_];
+    Node *node = current_ ? current_->next : head_;
+    if (node) {
+        current_ = node;
+        return *current_->line;
     } else return QString();
 }
 
 
 /** ***************************************************************************/
 QString History::prev() {
-    if (0 < currentLine_) {
-        --currentLine_;
-        return lines_[currentLine_];
+    if (current_ && current_->prev) {
+        current_ = current_->prev;
+        return *current_->line;
     } else return QString();
 }
 
 
 /** ***************************************************************************/
 void History::resetIterator() {
-    currentLine_ = -1;
+    current_ = nullptr;
 }
 
 
 /** ***************************************************************************/
-void History::updateHistory() {
+void History::clear() {
     lines_.clear();
-    QSqlQuery query;
-    query.exec("SELECT input FROM usages GROUP BY input ORDER BY max(timestamp) DESC");
-    while (query.next())
-        lines_.append(query.value(0).toString());
+    head_ = tail_ = current_ = nullptr;
 }
 
+
+/** ***************************************************************************/
+void History::onLoaded() {
+    // Lines added in the meantime are more recent than the loaded ones
+    for (const QString &line : loader_.result()) {
+        if (lines_.size() >= MAX_LINES)
+            break;
+        auto res = lines_.emplace(line, Node());
+        if (res.second) {
+            res.first->second.line = &res.first->first;
+            pushBack(&res.first->second);
+        }
+    }
+}
+
+
+/** ***************************************************************************/
+void History::unlink(Node *node) {
+    if (current_ == node)
+        current_ = nullptr;
+    (node->prev ? node->prev->next : head_) = node->next;
+    (node->next ? node->next->prev : tail_) = node->prev;
+}
+
+
+/** ***************************************************************************/
+void History::pushFront(Node *node) {
+    node->prev = nullptr;
+    node->next = head_;
+    (head_ ? head_->prev : tail_) = node;
+    head_ = node;
+}
+
+
+/** ***************************************************************************/
+void History::pushBack(Node *node) {
+    node->prev = tail_;
+    node->next = nullptr;
+    (tail_ ? tail_->next : head_) = node;
+    tail_ = node;
+}
+
+
+/** ***************************************************************************/
+void History::evict() {
+    Node *node = tail_;
+    unlink(node);
+    lines_.erase(lines_.find(*node->line));
+}
@@ -15,9 +15,19 @@
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #pragma once
+#include <QFutureWatcher>
 #include <QObject>
+#include <QString>
 #include <QStringList>
+#include <unordered_map>
 
+/**
+ * @brief The History class
+ * A deduplicated, bounded MRU list of the inputs the user activated items
+ * with. The lines live in a hash whose nodes are linked in MRU order, so
+ * adding a line and every navigation step are O(1). The history is loaded
+ * once in the background and kept current by add().
+ */
 class History final : public QObject
 {
     Q_OBJECT
@@ -25,18 +35,36 @@ class History final : public QObject
 public:
 
     History(QObject *parent = 0);
+    ~History();
 
     Q_INVOKABLE void add(QString str);
     Q_INVOKABLE QString next();
     Q_INVOKABLE QString prev();
     Q_INVOKABLE void resetIterator();
+    void clear();
 
 private:
 
-    void updateHistory();
+    struct Node {
+        const QString *line;
+        Node *prev;
+        Node *next;
+    };
 
-    QStringList lines_;
-    int currentLine_;
+    struct Hash {
+        size_t operator()(const QString &str) const;
+    };
 
-};
+    void onLoaded();
+    void unlink(Node *node);
+    void pushFront(Node *node);
+    void pushBack(Node *node);
+    void evict();
+
+    std::unordered_map<QString, Node, Hash> lines_;
+    Node *head_;
+    Node *tail_;
+    Node *current_; // nullptr means historymode is not active
+    QFutureWatcher<QStringList> loader_;
 
+};
@@ -0,0 +1,215 @@
+// albert - a simple application launcher for linux
+// Copyright (C) 2014-2016 Manuel Schneider
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <QDateTime>
+#include <QDebug>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include "iconcache.h"
+using std::map;
+
+namespace {
+
+const char MAGIC[8] = {'A','L','B','I','C','O','N','S'};
+const quint32 VERSION = 1;
+
+// The number of icons kept, the ones used recently and the new ones first
+const size_t MAX_ENTRIES = 1024;
+
+}
+
+// The file starts with the header, followed by the entries sorted by key and
+// the premultiplied ARGB32 pixels of the icons
+struct IconCache::Header {
+    char magic[8];
+    quint32 version;
+    quint32 count;
+};
+
+struct IconCache::Entry {
+    quint64 key;
+    quint64 offset;
+    quint32 width;  // Zero for unreadable icons
+    quint32 height;
+};
+
+
+/** ***************************************************************************/
+IconCache::IconCache(const QString &filePath) : file_(filePath), map_(nullptr), mapSize_(0) {
+
+    if ( !file_.open(QIODevice::ReadOnly) || file_.size() < static_cast<qint64>(sizeof(Header)) )
+        return;
+
+    map_ = file_.map(0, file_.size());
+    if ( map_ == nullptr )
+        return;
+    mapSize_ = file_.size();
+
+    // Ignore files of other versions and truncated files
+    const Header *header = reinterpret_cast<const Header*>(map_);
+    if ( std::memcmp(header->magic, MAGIC, sizeof(MAGIC)) != 0
+         || header->version != VERSION
+         || static_cast<qint64>(sizeof(Header) + header->count * sizeof(Entry)) > mapSize_ ) {
+        qWarning() << "Ignoring invalid icon cache" << filePath;
+        file_.unmap(const_cast<uchar*>(map_));
+        map_ = nullptr;
+        mapSize_ = 0;
+    }
+}
+
+
+/** ***************************************************************************/
+IconCache::~IconCache() {
+    write();
+}
+
+
+/** ***************************************************************************/
+quint64 IconCache::key(const QString &path, const QSize &size) {
+
+    // Changed icon files get other keys
+    QFileInfo fileInfo(path);
+    quint64 values[] = {
+        static_cast<quint64>(fileInfo.lastModified().toMSecsSinceEpoch()),
+        static_cast<quint64>(fileInfo.size()),
+        static_cast<quint64>(size.width()),
+        static_cast<quint64>(size.height())
+    };
+
+    // FNV-1a over the path and the values
+    quint64 h = 14695981039346656037ULL;
+    for ( const QChar &c : path ) {
+        h ^= c.unicode();
+        h *= 1099511628211ULL;
+    }
+    for ( quint64 value : values ) {
+        h ^= value;
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+
+/** ***************************************************************************/
+bool IconCache::find(quint64 key, QImage *image) {
+
+    QHash<quint64, QImage>::const_iterator it = added_.find(key);
+    if ( it != added_.end() ) {
+        *image = it.value();
+        return true;
+    }
+
+    const Entry *entry = findEntry(key);
+    if ( entry == nullptr )
+        return false;
+
+    used_.insert(key);
+    if ( entry->width == 0 || entry->height == 0 )
+        *image = QImage();
+    else
+        // Copied out of the mapping, it goes away when the file is rewritten
+        *image = QImage(map_ + entry->offset,
+                        static_cast<int>(entry->width),
+                        static_cast<int>(entry->height),
+                        static_cast<int>(entry->width) * 4,
+                        QImage::Format_ARGB32_Premultiplied).copy();
+    return true;
+}
+
+
+/** ***************************************************************************/
+void IconCache::insert(quint64 key, const QImage &image) {
+    // The file holds no more than MAX_ENTRIES icons, neither does the memory
+    if ( static_cast<size_t>(added_.size()) >= MAX_ENTRIES && !added_.contains(key) )
+        return;
+    added_.insert(key, image.isNull() ? QImage() : image.convertToFormat(QImage::Format_ARGB32_Premultiplied));
+}
+
+
+/** ***************************************************************************/
+const IconCache::Entry *IconCache::findEntry(quint64 key) const {
+
+    if ( map_ == nullptr )
+        return nullptr;
+
+    const Header *header = reinterpret_cast<const Header*>(map_);
+    const Entry *begin = reinterpret_cast<const Entry*>(map_ + sizeof(Header));
+    const Entry *end = begin + header->count;
+    const Entry *entry = std::lower_bound(begin, end, key, [](const Entry &e, quint64 k){ return e.key < k; });
+    if ( entry == end || entry->key != key )
+        return nullptr;
+
+    // Do not trust the offsets of a damaged file
+    if ( static_cast<qint64>(entry->offset + quint64(entry->width) * entry->height * 4) > mapSize_ )
+        return nullptr;
+    return entry;
+}
+
+
+/** ***************************************************************************/
+void IconCache::write() {
+
+    // Nothing new, the file on disk is still good
+    if ( added_.isEmpty() )
+        return;
+
+    // The new icons, the used ones and then the rest as long as there is room
+    map<quint64, QImage> images;
+    for ( QHash<quint64, QImage>::const_iterator it = added_.begin(); it != added_.end(); ++it )
+        images.emplace(it.key(), it.value());
+    if ( map_ != nullptr ) {
+        const Header *header = reinterpret_cast<const Header*>(map_);
+        const Entry *entries = reinterpret_cast<const Entry*>(map_ + sizeof(Header));
+        for ( int pass = 0; pass < 2; ++pass )
+            for ( quint32 i = 0; i < header->count && images.size() < MAX_ENTRIES; ++i )
+                if ( used_.contains(entries[i].key) == (pass == 0) ) {
+                    QImage image;
+                    if ( find(entries[i].key, &image) )
+                        images.emplace(entries[i].key, image);
+                }
+    }
+
+    QSaveFile file(file_.fileName());
+    if ( !file.open(QIODevice::WriteOnly) ) {
+        qWarning() << "Could not write icon cache" << file_.fileName();
+        return;
+    }
+
+    Header header;
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.count = static_cast<quint32>(images.size());
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    quint64 offset = sizeof(Header) + images.size() * sizeof(Entry);
+    for ( const auto &image : images ) {
+        Entry entry{image.first, offset,
+                    static_cast<quint32>(image.second.width()),
+                    static_cast<quint32>(image.second.height())};
+        file.write(reinterpret_cast<const char*>(&entry), sizeof(entry));
+        offset += quint64(entry.width) * entry.height * 4;
+    }
+
+    for ( const auto &image : images )
+        for ( int y = 0; y < image.second.height(); ++y )
+            file.write(reinterpret_cast<const char*>(image.second.constScanLine(y)), image.second.width() * 4);
+
+    if ( !file.commit() )
+        qWarning() << "Could not write icon cache" << file_.fileName();
+}
@@ -0,0 +1,62 @@
+// albert - a simple application launcher for linux
+// Copyright (C) 2014-2016 Manuel Schneider
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+#include <QFile>
+#include <QHash>
+#include <QImage>
+#include <QSet>
+#include <QSize>
+#include <QString>
+
+/**
+ * @brief The IconCache class
+ * A file of rasterized icons of one size, that survives restarts. Entries are
+ * addressed by a hash over the icon path, its modification time and file size
+ * and the raster size, so changed icons simply miss. The file is memory
+ * mapped, a hit costs a binary search and no decoding at all. New icons are
+ * collected and written back when the cache is destroyed.
+ */
+class IconCache final
+{
+public:
+
+    IconCache(const QString &filePath);
+    ~IconCache();
+
+    /** The address of the icon at the path rasterized at the size */
+    static quint64 key(const QString &path, const QSize &size);
+
+    /** Looks up an icon, the image of a hit is null for unreadable icons */
+    bool find(quint64 key, QImage *image);
+
+    void insert(quint64 key, const QImage &image);
+
+private:
+
+    struct Header;
+    struct Entry;
+
+    const Entry *findEntry(quint64 key) const;
+    void write();
+
+    QFile file_;
+    const uchar *map_;
+    qint64 mapSize_;
+    QSet<quint64> used_;
+    QHash<quint64, QImage> added_;
+
+};
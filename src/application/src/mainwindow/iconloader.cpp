@@ -0,0 +1,136 @@
+// albert - a simple application launcher for linux
+// Copyright (C) 2014-2016 Manuel Schneider
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <QDir>
+#include <QFutureWatcher>
+#include <QGuiApplication>
+#include <QImageReader>
+#include <QStandardPaths>
+#include <QtConcurrent>
+#include <algorithm>
+#include "iconcache.h"
+#include "iconloader.h"
+
+namespace {
+
+// The memory the loaded icons may take, a few hundred icons of list size
+const int CACHE_BUDGET_KB = 4096;
+
+// Decoding is cheap enough for a few threads, the query handlers need the rest
+const int DECODING_THREADS = 2;
+
+QImage loadIcon(const QString &path, const QSize &size) {
+
+    // Let the reader scale while decoding, vector images get rendered at size
+    QImageReader reader(path);
+    QSize imageSize = reader.size();
+    if ( imageSize.isValid() )
+        reader.setScaledSize(imageSize.scaled(size, Qt::KeepAspectRatio));
+
+    QImage image = reader.read();
+    if ( !image.isNull() && (image.width() > size.width() || image.height() > size.height()) )
+        image = image.scaled(size, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+    return image;
+}
+
+}
+
+/** ***************************************************************************/
+IconLoader::IconLoader(QObject *parent) : QObject(parent), cache_(CACHE_BUDGET_KB) {
+    pool_.setMaxThreadCount(DECODING_THREADS);
+}
+
+
+
+/** ***************************************************************************/
+IconLoader::~IconLoader() {
+    pool_.clear();
+    pool_.waitForDone();
+    qDeleteAll(diskCaches_);
+}
+
+
+
+/** ***************************************************************************/
+bool IconLoader::find(const QString &path, const QSize &size, QPixmap *pixmap) {
+
+    QString key = QString("%1x%2:%3").arg(size.width()).arg(size.height()).arg(path);
+
+    if ( QPixmap *cached = cache_.object(key) ) {
+        *pixmap = *cached;
+        return true;
+    }
+
+    // Scheduled already, repaints of waiting rows must not touch the disk
+    if ( pending_.contains(key) )
+        return false;
+
+    // Icons are rasterized for the pixels of the screen
+    qreal devicePixelRatio = qApp->devicePixelRatio();
+    QSize deviceSize = size * devicePixelRatio;
+
+    // Rasterized in an earlier session. The key stats the file, once per
+    // session, icons changing meanwhile show up after a restart.
+    IconCache *diskCache = this->diskCache(deviceSize);
+    QString deviceKey = QString("%1x%2:%3").arg(deviceSize.width()).arg(deviceSize.height()).arg(path);
+    QHash<QString, quint64>::iterator it = diskKeys_.find(deviceKey);
+    if ( it == diskKeys_.end() )
+        it = diskKeys_.insert(deviceKey, IconCache::key(path, deviceSize));
+    quint64 diskKey = it.value();
+    QImage image;
+    if ( diskCache->find(diskKey, &image) ) {
+        *pixmap = cache(key, image, devicePixelRatio);
+        return true;
+    }
+
+    // Schedule the icon once
+    pending_.insert(key);
+    QFutureWatcher<QImage> *watcher = new QFutureWatcher<QImage>(this);
+    connect(watcher, &QFutureWatcher<QImage>::finished, this,
+            [this, watcher, key, path, diskCache, diskKey, devicePixelRatio](){
+        QImage image = watcher->result();
+        pending_.remove(key);
+        diskCache->insert(diskKey, image);
+        cache(key, image, devicePixelRatio);
+        emit iconReady(path);
+        watcher->deleteLater();
+    });
+    watcher->setFuture(QtConcurrent::run(&pool_, loadIcon, path, deviceSize));
+    return false;
+}
+
+
+
+/** ***************************************************************************/
+IconCache *IconLoader::diskCache(const QSize &deviceSize) {
+    QString name = QString("icons-%1x%2.cache").arg(deviceSize.width()).arg(deviceSize.height());
+    IconCache *&diskCache = diskCaches_[name];
+    if ( diskCache == nullptr )
+        diskCache = new IconCache(QDir(QStandardPaths::writableLocation(QStandardPaths::CacheLocation)).filePath(name));
+    return diskCache;
+}
+
+
+
+/** ***************************************************************************/
+QPixmap IconLoader::cache(const QString &key, const QImage &image, qreal devicePixelRatio) {
+
+    // Unreadable icons are cached as null pixmaps, they are not retried
+    QPixmap pixmap = QPixmap::fromImage(image);
+    pixmap.setDevicePixelRatio(devicePixelRatio);
+    cache_.insert(key, new QPixmap(pixmap), std::max(1, image.byteCount() / 1024));
+    return pixmap;
+}
@@ -0,0 +1,67 @@
+// albert - a simple application launcher for linux
+// Copyright (C) 2014-2016 Manuel Schneider
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+#include <QCache>
+#include <QHash>
+#include <QImage>
+#include <QObject>
+#include <QPixmap>
+#include <QSet>
+#include <QSize>
+#include <QString>
+#include <QThreadPool>
+class IconCache;
+
+/**
+ * @brief The IconLoader class
+ * Decodes and scales icons on worker threads, so that painting never renders
+ * SVGs or scales images on the GUI thread. A miss schedules the icon and
+ * returns at once, iconReady() tells when it can be painted. Rasterized icons
+ * are kept on disk, so after a restart they are read back without decoding.
+ */
+class IconLoader final : public QObject
+{
+    Q_OBJECT
+
+public:
+
+    IconLoader(QObject *parent = 0);
+    ~IconLoader();
+
+    /**
+     * Looks up the icon at the path scaled to fit the size. Returns false and
+     * schedules the icon if it is not loaded yet. The pixmap is null for
+     * icons that can not be read.
+     */
+    bool find(const QString &path, const QSize &size, QPixmap *pixmap);
+
+private:
+
+    IconCache *diskCache(const QSize &deviceSize);
+    QPixmap cache(const QString &key, const QImage &image, qreal devicePixelRatio);
+
+    QCache<QString, QPixmap> cache_; // Cost is in kilobytes
+    QHash<QString, IconCache*> diskCaches_;
+    QHash<QString, quint64> diskKeys_; // The file stats are taken once
+    QSet<QString> pending_;
+    QThreadPool pool_;
+
+signals:
+
+    void iconReady(const QString &path);
+
+};
@@ -19,6 +19,7 @@
 #include <QApplication>
 #include <QCloseEvent>
 #include <QCursor>
+#include <QDebug>
 #include <QDesktopWidget>
 #include <QDir>
 #include <QEvent>
@@ -52,6 +53,8 @@ const char*   CFG_DISPLAY_ICONS = "displayIcons";
 const bool    DEF_DISPLAY_ICONS = true;
 const char*   CFG_DISPLAY_SHADOW = "displayShadow";
 const bool    DEF_DISPLAY_SHADOW = true;
+const char*   CFG_PRE_REALIZE = "preRealizeWindow";
+const bool    DEF_PRE_REALIZE = false;
 
 }
 
@@ -60,7 +63,11 @@ const bool    DEF_DISPLAY_SHADOW = true;
 MainWindow::MainWindow(QWidget *parent)
     : QWidget(parent),
       actionsShown_(false),
-      historyMoveMod_(Qt::ControlModifier) {
+      historyMoveMod_(Qt::ControlModifier),
+      shownOnce_(false),
+      framePending_(false),
+      focusPending_(false),
+      hideLatency_(0) {
 
 	// INITIALIZE UI
     ui.setupUi(this);
@@ -89,6 +96,10 @@ MainWindow::MainWindow(QWidget *parent)
     actionsListModel_ = new QStringListModel(this);
     ui.actionList->setModel(actionsListModel_);
 
+    // Set the persistent results model for the proposal view
+    resultsModel_ = new ResultsModel(this);
+    ui.proposalList->setModel(resultsModel_);
+
     // Hide lists
     ui.actionList->hide();
     ui.proposalList->hide();
@@ -146,6 +157,10 @@ MainWindow::MainWindow(QWidget *parent)
         qApp->quit();
     }
 
+    // Set up the native window before the hotkey is pressed the first time
+    if (s.value(CFG_PRE_REALIZE, DEF_PRE_REALIZE).toBool())
+        QTimer::singleShot(0, this, SLOT(realize()));
+
 
     /*
      * Signals
@@ -166,6 +181,10 @@ MainWindow::MainWindow(QWidget *parent)
     // Trigger default action, if item in proposallist was activated
     QObject::connect(ui.proposalList, &ProposalList::activated, [this](const QModelIndex &index){
 
+        // The action runs after hiding, measure how long hiding takes
+        QElapsedTimer activationTimer;
+        activationTimer.start();
+
         switch (qApp->queryKeyboardModifiers()) {
         case Qt::AltModifier: // AltAction
             ui.proposalList->model()->setData(index, -1, Qt::UserRole+101);
@@ -188,13 +207,17 @@ MainWindow::MainWindow(QWidget *parent)
         history_->add(ui.inputLine->text());
         this->setVisible(false);
         ui.inputLine->clear();
+        hideLatency_ = activationTimer.nsecsElapsed() / 1000;
     });
 
     // Trigger alternative action, if item in actionList was activated
     QObject::connect(ui.actionList, &ActionList::activated, [this](const QModelIndex &index){
         history_->add(ui.inputLine->text());
+        QElapsedTimer activationTimer;
+        activationTimer.start();
         ui.proposalList->model()->setData(ui.proposalList->currentIndex(), index.row(), Qt::UserRole);
         this->setVisible(false);
+        hideLatency_ = activationTimer.nsecsElapsed() / 1000;
     });
 }
 
@@ -207,22 +230,39 @@ void MainWindow::setVisible(bool visible) {
     if ( (isVisible() && visible) || !(isVisible() || visible) )
         return;
 
-    QWidget::setVisible(visible);
-
     if (visible) {
-        // Move widget after showing it since QWidget::move works only on widgets
-        // that have been shown once. Well as long as this does not introduce ugly
-        // flicker this may be okay.
-        if (showCentered_){
-            QDesktopWidget *dw = QApplication::desktop();
-            this->move(dw->availableGeometry(dw->screenNumber(QCursor::pos())).center()
-                       -QPoint(rect().right()/2,192 ));
+
+        // The hotkey handler calls this directly, so this is the time of the press
+        showTimer_.start();
+        showPhases_.clear();
+        framePending_ = true;
+        focusPending_ = true;
+
+        // QWidget::move works only on widgets that have been shown once. Once
+        // the native window exists, move before mapping to save a round trip.
+        if (shownOnce_) {
+            moveToCursorScreen();
+            recordShowPhase("position");
         }
+
+        QWidget::setVisible(true);
+        recordShowPhase("map");
+
+        if (!shownOnce_) {
+            shownOnce_ = true;
+            moveToCursorScreen();
+            recordShowPhase("position");
+        }
+
         this->raise();
         this->activateWindow();
         ui.inputLine->setFocus();
+        recordShowPhase("activate");
+
         emit widgetShown();
+        recordShowPhase("session");
     } else {
+        QWidget::setVisible(false);
         setShowActions(false);
         history_->resetIterator();
         ( clearOnHide_ ) ? ui.inputLine->clear() : ui.inputLine->selectAll();
@@ -231,6 +271,71 @@ void MainWindow::setVisible(bool visible) {
 }
 
 
+/** ***************************************************************************/
+void MainWindow::moveToCursorScreen() {
+    if (showCentered_){
+        QDesktopWidget *dw = QApplication::desktop();
+        this->move(dw->availableGeometry(dw->screenNumber(QCursor::pos())).center()
+                   -QPoint(rect().right()/2,192 ));
+    }
+}
+
+
+/** ***************************************************************************/
+void MainWindow::realize() {
+    if (shownOnce_)
+        return;
+
+    // Create the native window without mapping it, then show and paint the
+    // widget once without putting it on screen. The polish, the layout and
+    // the backing store are set up then and the first show is a plain map.
+    // Nothing is mapped, window managers may not honour off-screen positions.
+    create();
+    setAttribute(Qt::WA_DontShowOnScreen);
+    QWidget::setVisible(true);
+    repaint();
+    QWidget::setVisible(false);
+    setAttribute(Qt::WA_DontShowOnScreen, false);
+    shownOnce_ = true;
+}
+
+
+/** ***************************************************************************/
+void MainWindow::recordShowPhase(const char *phase) {
+    if (!showTimer_.isValid())
+        return;
+    showPhases_.emplace_back(phase, showTimer_.nsecsElapsed() / 1000);
+
+    // Done when the first frame is painted and the window has the focus
+    if ( framePending_ || focusPending_ )
+        return;
+
+    QStringList phases;
+    for ( const std::pair<const char*, qint64> &showPhase : showPhases_ )
+        phases.append(QString("%1 %2").arg(showPhase.first).arg(showPhase.second));
+    showLatency_ = QString("Shown after %1 microseconds (%2)").arg(showPhases_.back().second).arg(phases.join(", "));
+    // Release builds compile out the debug output
+#if QT_VERSION >= QT_VERSION_CHECK(5, 5, 0)
+    qInfo() << qPrintable(showLatency_);
+#else
+    qWarning() << qPrintable(showLatency_);
+#endif
+    showTimer_.invalidate();
+}
+
+
+/** ***************************************************************************/
+const QString &MainWindow::showLatency() const {
+    return showLatency_;
+}
+
+
+/** ***************************************************************************/
+qint64 MainWindow::hideLatency() const {
+    return hideLatency_;
+}
+
+
 /** ***************************************************************************/
 void MainWindow::toggleVisibility() {
    setVisible(!isVisible());
@@ -246,7 +351,22 @@ void MainWindow::setInput(const QString &input) {
 
 /** ***************************************************************************/
 void MainWindow::setModel(QAbstractItemModel *m) {
-    ui.proposalList->setModel(m);
+
+    // Follow the best match, unless the user selected another one
+    bool followTop = ui.proposalList->currentIndex().row() <= 0;
+
+    // The list keeps its model, only the rows that changed get updated
+    resultsModel_->setSourceModel(m);
+
+    if ( followTop && resultsModel_->rowCount() > 0 )
+        ui.proposalList->setCurrentIndex(resultsModel_->index(0, 0));
+}
+
+
+
+/** ***************************************************************************/
+void MainWindow::clearHistory() {
+    history_->clear();
 }
 
 
@@ -570,6 +690,19 @@ bool MainWindow::eventFilter(QObject *, QEvent *event) {
 
 /** ***************************************************************************/
 bool MainWindow::event(QEvent *event) {
+
+    // Measure the time until the window is usable
+    if (event->type() == QEvent::Paint && framePending_) {
+        bool result = QWidget::event(event);
+        framePending_ = false;
+        recordShowPhase("frame");
+        return result;
+    }
+    if (event->type() == QEvent::WindowActivate && focusPending_) {
+        focusPending_ = false;
+        recordShowPhase("focus");
+    }
+
     if (event->type() == QEvent::WindowDeactivate) {
         /* This is a horribly hackish but working solution.
 
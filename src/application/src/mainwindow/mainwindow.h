@@ -15,11 +15,15 @@
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #pragma once
+#include <QElapsedTimer>
 #include <QWidget>
+#include <utility>
+#include <vector>
 #include <QStringListModel>
 #include "proposallist.h"
 #include "settingsbutton.h"
 #include "history.h"
+#include "resultsmodel.h"
 #include "ui_mainwindow.h"
 class QAbstractItemModel;
 
@@ -34,6 +38,12 @@ public:
     void setVisible(bool visible) override;
     void toggleVisibility();
 
+    /** The phases of the last show in microseconds since the request */
+    const QString &showLatency() const;
+
+    /** The microseconds from the last activation until the window was hidden */
+    qint64 hideLatency() const;
+
     void setInput(const QString&);
 
     bool showCentered() const;
@@ -68,6 +78,8 @@ public:
 
     void setModel(QAbstractItemModel *);
 
+    void clearHistory();
+
     bool actionsAreShown() const;
     void setShowActions(bool showActions);
     void showActions() { setShowActions(true); }
@@ -83,8 +95,15 @@ protected:
     bool event(QEvent *event) override;
     bool eventFilter(QObject*, QEvent *event) override;
 
+private slots:
+
+    void realize();
+
 private:
 
+    void moveToCursorScreen();
+    void recordShowPhase(const char *phase);
+
     /** The name of the current theme */
     QString theme_;
 
@@ -112,6 +131,9 @@ private:
     /** The model of the action list view */
     QStringListModel *actionsListModel_;
 
+    /** The model of the proposal list, it mirrors the current results */
+    ResultsModel *resultsModel_;
+
     /** The button to open the settings dialog */
     SettingsButton *settingsButton_;
 
@@ -121,6 +143,17 @@ private:
     /** The modifier used to navigate directly in the history */
     Qt::KeyboardModifier historyMoveMod_;
 
+    /** Indicates that the native window exists, it can be moved before mapping */
+    bool shownOnce_;
+
+    /** Measures the phases of showing the window */
+    QElapsedTimer showTimer_;
+    std::vector<std::pair<const char*, qint64>> showPhases_;
+    bool framePending_;
+    bool focusPending_;
+    QString showLatency_;
+    qint64 hideLatency_;
+
     /** The form of the main app */
     Ui::MainWindow ui;
 
@@ -16,27 +16,79 @@
 
 #include <QKeyEvent>
 #include <QPainter>
-#include <QPixmapCache>
+#include <unordered_map>
 #include "proposallist.h"
 
+namespace {
+
+// The number of row layouts kept, a few pages of rows in all modifier states
+const size_t MAX_LAYOUTS = 256;
+
+}
+
 /** ***************************************************************************/
 class ProposalList::ItemDelegate final : public QStyledItemDelegate
 {
 public:
-    ItemDelegate(QObject *parent = nullptr)
-        : QStyledItemDelegate(parent), drawIcon(true) {}
+    ItemDelegate(IconLoader *iconLoader, QObject *parent = nullptr)
+        : QStyledItemDelegate(parent), drawIcon(true), iconLoader(iconLoader),
+          subTextRole(Qt::UserRole+100), fontMetrics1(font1), fontMetrics2(font2) {}
 
     void paint(QPainter *painter, const QStyleOptionViewItem &options, const QModelIndex &index) const override;
 
     bool drawIcon;
+    IconLoader *iconLoader;
     int subTextRole;
+
+    /** The texts of a row elided to its width, rects relative to the row */
+    struct Layout {
+        QString text;
+        QString subtext;
+        QString elidedText;
+        QString elidedSubtext;
+        QRect textRect;
+        QRect subTextRect;
+    };
+
+    struct LayoutKey {
+        qulonglong itemId;
+        int width;
+        int role;
+        bool operator==(const LayoutKey &other) const {
+            return itemId == other.itemId && width == other.width && role == other.role;
+        }
+    };
+
+    struct LayoutKeyHash {
+        size_t operator()(const LayoutKey &key) const {
+            return std::hash<qulonglong>()(key.itemId) ^ (static_cast<size_t>(key.width) << 16) ^ static_cast<size_t>(key.role);
+        }
+    };
+
+    /** Drops the layouts, e.g. when the width or the style changed */
+    void clearLayouts() { layouts.clear(); }
+
+private:
+
+    const Layout &layout(const QStyleOptionViewItem &option, const QModelIndex &index, int role) const;
+
+    // The fonts change with the theme only
+    mutable QFont font1;
+    mutable QFont font2;
+    mutable QFontMetrics fontMetrics1;
+    mutable QFontMetrics fontMetrics2;
+    mutable std::unordered_map<LayoutKey, Layout, LayoutKeyHash> layouts;
 };
 
 
 
 /** ***************************************************************************/
 ProposalList::ProposalList(QWidget *parent) : ResizingList(parent) {
-    setItemDelegate(delegate_ = new ItemDelegate(this));
+    iconLoader_ = new IconLoader(this);
+    setItemDelegate(delegate_ = new ItemDelegate(iconLoader_, this));
+
+    // Icons are loaded in the background, repaint the rows when they arrive
+    connect(iconLoader_, &IconLoader::iconReady, this, &ProposalList::onIconReady);
 
     // Single click activation (segfaults without queued connection)
     connect(this, &ProposalList::clicked, this, &ProposalList::activated, Qt::QueuedConnection);
@@ -54,11 +106,46 @@ bool ProposalList::displayIcons() const {
 /** ***************************************************************************/
 void ProposalList::setDisplayIcons(bool value) {
     delegate_->drawIcon = value;
+    delegate_->clearLayouts();
     update();
 }
 
 
 
+/** ***************************************************************************/
+void ProposalList::onIconReady(const QString &path) {
+    if ( model() == nullptr )
+        return;
+
+    // Only the visible rows can be waiting for the icon
+    QModelIndex index = indexAt(viewport()->rect().topLeft());
+    while ( index.isValid() && visualRect(index).top() < viewport()->height() ) {
+        if ( index.data(Qt::DecorationRole).toString() == path )
+            update(index);
+        index = model()->index(index.row() + 1, 0);
+    }
+}
+
+
+
+/** ***************************************************************************/
+void ProposalList::resizeEvent(QResizeEvent *event) {
+    delegate_->clearLayouts();
+    ResizingList::resizeEvent(event);
+}
+
+
+
+/** ***************************************************************************/
+void ProposalList::changeEvent(QEvent *event) {
+    // Themes change fonts and margins
+    if ( event->type() == QEvent::StyleChange || event->type() == QEvent::FontChange )
+        delegate_->clearLayouts();
+    ResizingList::changeEvent(event);
+}
+
+
+
 /** ***************************************************************************/
 bool ProposalList::eventFilter(QObject*, QEvent *event) {
 
@@ -88,7 +175,8 @@ bool ProposalList::eventFilter(QObject*, QEvent *event) {
                 delegate_->subTextRole = Qt::UserRole+100;
                 break;
             }
-            update();
+            // Only the selected row shows the action
+            update(currentIndex());
             return false;
 
         // Navigation
@@ -130,7 +218,8 @@ bool ProposalList::eventFilter(QObject*, QEvent *event) {
                 delegate_->subTextRole = Qt::UserRole+100;
                 break;
             }
-            update();
+            // Only the selected row shows the action
+            update(currentIndex());
             return false;
         }
     }
@@ -178,46 +267,81 @@ void ProposalList::ItemDelegate::paint(QPainter *painter, const QStyleOptionView
                     QPoint((option.rect.height() - option.decorationSize.width())/2 + option.rect.x(),
                            (option.rect.height() - option.decorationSize.height())/2 + option.rect.y()),
                     option.decorationSize);
+
+        // The icon area stays empty until the loader has the icon
         QPixmap pixmap;
         QString iconPath = index.data(Qt::DecorationRole).value<QString>();
-        QString cacheKey = QString("%1%2%3").arg(option.decorationSize.width(), option.decorationSize.height()).arg(iconPath);
-        if ( !QPixmapCache::find(cacheKey, &pixmap) ) {
-            pixmap = QPixmap(iconPath).scaled(option.decorationSize, Qt::KeepAspectRatio, Qt::SmoothTransformation);
-            QPixmapCache::insert(cacheKey, pixmap);
+        if ( iconLoader->find(iconPath, option.decorationSize, &pixmap) && !pixmap.isNull() ) {
+            QSize size = pixmap.size() / pixmap.devicePixelRatio();
+            painter->drawPixmap(QRect(iconRect.topLeft() + QPoint((iconRect.width() - size.width())/2,
+                                                                   (iconRect.height() - size.height())/2),
+                                      size),
+                                pixmap);
         }
-        painter->drawPixmap(iconRect, pixmap);
     }
 
-    // Calculate text rects
-    QFont font1 = option.font;
-    QFont font2 = option.font;
-    font2.setPixelSize(12);
-    QFontMetrics fontMetrics1 = QFontMetrics(font1);
-    QFontMetrics fontMetrics2 = QFontMetrics(font2);
-    QRect contentRect = option.rect;
-    contentRect.setLeft(drawIcon ? option.rect.height() : 0);
-    contentRect.setTop(option.rect.y()+option.rect.height()/2-(fontMetrics1.height()+fontMetrics2.height())/2);
-    contentRect.setBottom(option.rect.y()+option.rect.height()/2+(fontMetrics1.height()+fontMetrics2.height())/2);
-    QRect textRect = contentRect.adjusted(0,-2,0,-fontMetrics2.height()-2);
-    QRect subTextRect = contentRect.adjusted(0,fontMetrics1.height()-2,0,-2);
+    // Get the elided texts and their rects
+    const Layout &layout = this->layout(option, index, option.state.testFlag(QStyle::State_Selected) ? subTextRole : Qt::ToolTipRole);
+    QRect textRect = layout.textRect.translated(option.rect.topLeft());
+    QRect subTextRect = layout.subTextRect.translated(option.rect.topLeft());
 
     //    // Test
     //    painter->fillRect(iconRect, Qt::magenta);
-    //    painter->fillRect(contentRect, Qt::red);
     //    painter->fillRect(textRect, Qt::blue);
     //    painter->fillRect(subTextRect, Qt::yellow);
 
 
     // Draw display role
     painter->setFont(font1);
-    QString text = fontMetrics1.elidedText(index.data(Qt::DisplayRole).toString(), option.textElideMode, textRect.width());
-    option.widget->style()->drawItemText(painter, textRect, option.displayAlignment, option.palette, option.state & QStyle::State_Enabled, text, QPalette::WindowText);
+    option.widget->style()->drawItemText(painter, textRect, option.displayAlignment, option.palette, option.state & QStyle::State_Enabled, layout.elidedText, QPalette::WindowText);
     //    painter->drawText(textRect, Qt::AlignTop|Qt::AlignLeft, text);
 
     // Draw tooltip role
     painter->setFont(font2);
-    text = fontMetrics2.elidedText(index.data(option.state.testFlag(QStyle::State_Selected) ? subTextRole : Qt::ToolTipRole).toString(), option.textElideMode, subTextRect.width());
-    painter->drawText(subTextRect, Qt::AlignBottom|Qt::AlignLeft, text);
+    painter->drawText(subTextRect, Qt::AlignBottom|Qt::AlignLeft, layout.elidedSubtext);
 
     painter->restore();
 }
+
+
+
+/** ***************************************************************************/
+const ProposalList::ItemDelegate::Layout &
+ProposalList::ItemDelegate::layout(const QStyleOptionViewItem &option, const QModelIndex &index, int role) const {
+
+    if ( option.font != font1 ) {
+        font1 = option.font;
+        font2 = option.font;
+        font2.setPixelSize(12);
+        fontMetrics1 = QFontMetrics(font1);
+        fontMetrics2 = QFontMetrics(font2);
+        layouts.clear();
+    }
+
+    // The texts of an item may change with the input, e.g. calculations
+    QString text = index.data(Qt::DisplayRole).toString();
+    QString subtext = index.data(role).toString();
+    LayoutKey key{index.data(Qt::UserRole+105).toULongLong(), option.rect.width(), role};
+    auto it = layouts.find(key);
+    if ( it != layouts.end() && it->second.text == text && it->second.subtext == subtext )
+        return it->second;
+
+    if ( layouts.size() >= MAX_LAYOUTS )
+        layouts.clear();
+
+    // Calculate text rects
+    Layout &layout = layouts[key];
+    QRect rowRect(QPoint(0, 0), option.rect.size());
+    QRect contentRect = rowRect;
+    contentRect.setLeft(drawIcon ? rowRect.height() : 0);
+    contentRect.setTop(rowRect.height()/2-(fontMetrics1.height()+fontMetrics2.height())/2);
+    contentRect.setBottom(rowRect.height()/2+(fontMetrics1.height()+fontMetrics2.height())/2);
+    layout.textRect = contentRect.adjusted(0,-2,0,-fontMetrics2.height()-2);
+    layout.subTextRect = contentRect.adjusted(0,fontMetrics1.height()-2,0,-2);
+
+    layout.text = text;
+    layout.subtext = subtext;
+    layout.elidedText = fontMetrics1.elidedText(text, option.textElideMode, layout.textRect.width());
+    layout.elidedSubtext = fontMetrics2.elidedText(subtext, option.textElideMode, layout.subTextRect.width());
+    return layout;
+}
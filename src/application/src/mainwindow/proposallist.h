@@ -17,6 +17,7 @@
 #pragma once
 #include <QEvent>
 #include "resizinglist.h"
+#include "iconloader.h"
 #include <QStyledItemDelegate>
 
 class ProposalList final : public ResizingList
@@ -34,6 +35,10 @@ public:
 private:
 
     bool eventFilter(QObject*, QEvent *event) override;
+    void resizeEvent(QResizeEvent *event) override;
+    void changeEvent(QEvent *event) override;
+    void onIconReady(const QString &path);
 
     ItemDelegate *delegate_;
+    IconLoader *iconLoader_;
 };
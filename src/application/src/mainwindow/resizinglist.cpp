@@ -55,6 +55,7 @@ void ResizingList::setModel(QAbstractItemModel * m) {
 
     if (model()!=nullptr) {
         disconnect(this->model(), &QAbstractItemModel::rowsInserted, this, &ResizingList::updateAppearance);
+        disconnect(this->model(), &QAbstractItemModel::rowsRemoved, this, &ResizingList::updateAppearance);
         disconnect(this->model(), &QAbstractItemModel::modelReset, this, &ResizingList::updateAppearance);
     }
 
@@ -66,6 +67,7 @@ void ResizingList::setModel(QAbstractItemModel * m) {
     // If not empty show and select first, update geom. If not null connect.
     if (model()!=nullptr) {
         connect(this->model(), &QAbstractItemModel::rowsInserted, this, &ResizingList::updateAppearance);
+        connect(this->model(), &QAbstractItemModel::rowsRemoved, this, &ResizingList::updateAppearance);
         connect(this->model(), &QAbstractItemModel::modelReset, this, &ResizingList::updateAppearance);
     }
 }
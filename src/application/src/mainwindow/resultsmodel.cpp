@@ -0,0 +1,205 @@
+// albert - a simple application launcher for linux
+// Copyright (C) 2014-2016 Manuel Schneider
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <QVariant>
+#include <algorithm>
+#include <unordered_map>
+#include "resultsmodel.h"
+using std::vector;
+
+namespace {
+
+// The role the query models expose the item ids with
+const int ID_ROLE = Qt::UserRole+105;
+
+}
+
+/** ***************************************************************************/
+ResultsModel::ResultsModel(QObject *parent)
+    : QAbstractListModel(parent), source_(nullptr) {
+
+}
+
+
+
+/** ***************************************************************************/
+QAbstractItemModel *ResultsModel::sourceModel() const {
+    return source_;
+}
+
+
+
+/** ***************************************************************************/
+void ResultsModel::setSourceModel(QAbstractItemModel *model) {
+
+    if ( source_ == model ) {
+        sync();
+        return;
+    }
+
+    if ( source_ != nullptr )
+        disconnect(source_, nullptr, this, nullptr);
+
+    source_ = model;
+
+    // Any structural change of the source is diffed into this model
+    if ( source_ != nullptr ) {
+        connect(source_, &QAbstractItemModel::rowsInserted, this, &ResultsModel::sync);
+        connect(source_, &QAbstractItemModel::rowsRemoved, this, &ResultsModel::sync);
+        connect(source_, &QAbstractItemModel::rowsMoved, this, &ResultsModel::sync);
+        connect(source_, &QAbstractItemModel::modelReset, this, &ResultsModel::sync);
+        connect(source_, &QAbstractItemModel::layoutChanged, this, &ResultsModel::sync);
+        connect(source_, &QAbstractItemModel::dataChanged, this, &ResultsModel::onSourceDataChanged);
+    }
+
+    sync();
+
+    // Kept items may display differently for the new input, e.g. calculations
+    if ( !ids_.empty() )
+        emit dataChanged(index(0, 0), index(static_cast<int>(ids_.size())-1, 0));
+}
+
+
+
+/** ***************************************************************************/
+int ResultsModel::rowCount(const QModelIndex &parent) const {
+    return parent.isValid() ? 0 : static_cast<int>(ids_.size());
+}
+
+
+
+/** ***************************************************************************/
+QVariant ResultsModel::data(const QModelIndex &index, int role) const {
+    if ( source_ == nullptr || !index.isValid() )
+        return QVariant();
+    return source_->data(source_->index(index.row(), 0), role);
+}
+
+
+
+/** ***************************************************************************/
+bool ResultsModel::setData(const QModelIndex &index, const QVariant &value, int role) {
+    if ( source_ == nullptr || !index.isValid() )
+        return false;
+    return source_->setData(source_->index(index.row(), 0), value, role);
+}
+
+
+
+/** ***************************************************************************/
+bool ResultsModel::canFetchMore(const QModelIndex &parent) const {
+    return source_ != nullptr && !parent.isValid() && source_->canFetchMore(QModelIndex());
+}
+
+
+
+/** ***************************************************************************/
+void ResultsModel::fetchMore(const QModelIndex &parent) {
+    // The source announces the new rows, sync() picks them up
+    if ( source_ != nullptr && !parent.isValid() )
+        source_->fetchMore(QModelIndex());
+}
+
+
+
+/** ***************************************************************************/
+void ResultsModel::sync() {
+
+    // The ids of the rows the source has now
+    vector<uint64_t> target;
+    if ( source_ != nullptr ) {
+        int rows = source_->rowCount();
+        target.reserve(static_cast<size_t>(rows));
+        for ( int row = 0; row < rows; ++row )
+            target.push_back(source_->data(source_->index(row, 0), ID_ROLE).toULongLong());
+    }
+
+    // Count the ids, items may be returned more than once
+    std::unordered_map<uint64_t, int> wanted;
+    for ( uint64_t id : target )
+        ++wanted[id];
+
+    // Remove the rows that are gone, back to front in contiguous runs
+    vector<bool> keep(ids_.size());
+    for ( size_t row = 0; row < ids_.size(); ++row ) {
+        auto it = wanted.find(ids_[row]);
+        keep[row] = it != wanted.end() && it->second-- > 0;
+    }
+    for ( size_t end = ids_.size(); end > 0; ) {
+        if ( keep[end-1] ) {
+            --end;
+            continue;
+        }
+        size_t begin = end - 1;
+        while ( begin > 0 && !keep[begin-1] )
+            --begin;
+        beginRemoveRows(QModelIndex(), static_cast<int>(begin), static_cast<int>(end-1));
+        ids_.erase(ids_.begin() + static_cast<long>(begin), ids_.begin() + static_cast<long>(end));
+        endRemoveRows();
+        end = begin;
+    }
+
+    // The ids of the kept rows not placed yet
+    std::unordered_map<uint64_t, int> unplaced;
+    for ( uint64_t id : ids_ )
+        ++unplaced[id];
+
+    // Bring the kept rows into order and insert the new ones around them
+    for ( size_t row = 0; row < target.size(); ) {
+        const uint64_t id = target[row];
+        auto it = unplaced.find(id);
+
+        if ( it == unplaced.end() || it->second == 0 ) {
+
+            // A run of new rows
+            size_t end = row + 1;
+            while ( end < target.size() ) {
+                auto next = unplaced.find(target[end]);
+                if ( next != unplaced.end() && next->second > 0 )
+                    break;
+                ++end;
+            }
+            beginInsertRows(QModelIndex(), static_cast<int>(row), static_cast<int>(end-1));
+            ids_.insert(ids_.begin() + static_cast<long>(row),
+                        target.begin() + static_cast<long>(row), target.begin() + static_cast<long>(end));
+            endInsertRows();
+            row = end;
+            continue;
+        }
+
+        --it->second;
+        if ( ids_[row] != id ) {
+
+            // A kept row further down moved up
+            size_t from = static_cast<size_t>(std::find(ids_.begin() + static_cast<long>(row), ids_.end(), id) - ids_.begin());
+            beginMoveRows(QModelIndex(), static_cast<int>(from), static_cast<int>(from),
+                          QModelIndex(), static_cast<int>(row));
+            ids_.erase(ids_.begin() + static_cast<long>(from));
+            ids_.insert(ids_.begin() + static_cast<long>(row), id);
+            endMoveRows();
+        }
+        ++row;
+    }
+}
+
+
+
+/** ***************************************************************************/
+void ResultsModel::onSourceDataChanged(const QModelIndex &topLeft,
+                                       const QModelIndex &bottomRight,
+                                       const QVector<int> &roles) {
+    emit dataChanged(index(topLeft.row(), 0), index(bottomRight.row(), 0), roles);
+}
@@ -0,0 +1,55 @@
+// albert - a simple application launcher for linux
+// Copyright (C) 2014-2016 Manuel Schneider
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+#include <QAbstractListModel>
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief The ResultsModel class
+ * The model the proposal list shows for the whole lifetime of the window. It
+ * mirrors the results of the current query and, when the query changes,
+ * diffs the rows of the old and the new results by item id. Only the rows
+ * that really changed are inserted, removed or moved, so the view keeps its
+ * layout, its caches and the selection across keystrokes.
+ */
+class ResultsModel final : public QAbstractListModel
+{
+    Q_OBJECT
+
+public:
+
+    ResultsModel(QObject *parent = 0);
+
+    QAbstractItemModel *sourceModel() const;
+    void setSourceModel(QAbstractItemModel *);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role) const override;
+    bool setData(const QModelIndex &index, const QVariant &value, int role) override;
+    bool canFetchMore(const QModelIndex &parent) const override;
+    void fetchMore(const QModelIndex &parent) override;
+
+private:
+
+    void sync();
+    void onSourceDataChanged(const QModelIndex &topLeft, const QModelIndex &bottomRight, const QVector<int> &roles);
+
+    QAbstractItemModel *source_;
+    std::vector<uint64_t> ids_; // The item ids of the rows, in order
+
+};
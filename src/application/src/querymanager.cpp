@@ -14,32 +14,124 @@
 // You should have received a copy of the GNU General Public License
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
+#include <QApplication>
 #include <QDebug>
+#include <QSettings>
+#include <QSqlDatabase>
 #include <QSqlQuery>
-#include <QSqlRecord>
-#include <QSqlError>
+#include <QStringList>
+#include <QVariant>
+#include <QtConcurrent>
 #include <vector>
 #include "extension.h"
 #include "extensionmanager.h"
 #include "fallbackprovider.h"
+#include "frecencymodel.h"
 #include "item.h"
-#include "matchcompare.h"
+#include "persistencethread.h"
 #include "query.h"
 #include "queryhandler.h"
 #include "querymanager.h"
 using namespace Core;
+using std::map;
+using std::pair;
 using std::set;
 using std::vector;
 using std::shared_ptr;
 
+namespace {
+
+const char* CFG_STABLE_ROWS = "stableRows";
+const uint  DEF_STABLE_ROWS = 5;
+const char* CFG_WANTED_RESULTS = "wantedResults";
+const uint  DEF_WANTED_RESULTS = 100;
+const char* CFG_RESULT_CACHE_SIZE = "resultCacheSize";
+const uint  DEF_RESULT_CACHE_SIZE = 0;
+
+// The number of results cached per query
+const size_t CACHED_RESULTS = 50;
+
+// The number of most frequent and most recent inputs to prewarm
+const int PREWARM_INPUTS = 5;
+
+// The most frequent and most recent inputs, loaded on an own connection
+QStringList loadLikelyInputs(const QString &databaseName) {
+    QStringList inputs;
+    {
+        QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", "prewarm");
+        db.setDatabaseName(databaseName);
+        if (db.open()) {
+            QSqlQuery query(db);
+            for ( const char *order : { "count(*)", "max(timestamp)" } ) {
+                query.exec(QString("SELECT input FROM usages GROUP BY input ORDER BY %1 DESC LIMIT %2")
+                           .arg(order).arg(PREWARM_INPUTS));
+                while (query.next())
+                    if ( !inputs.contains(query.value(0).toString()) )
+                        inputs.append(query.value(0).toString());
+            }
+        } else
+            qWarning() << "Could not load the inputs to prewarm.";
+    }
+    QSqlDatabase::removeDatabase("prewarm");
+    return inputs;
+}
+
+// The cache key of a query: normalized search term and the handlers
+QString cacheKey(const QString &searchTerm, const set<QueryHandler*> &handlers) {
+    QStringList handlerIds;
+    for ( QueryHandler *handler : handlers )
+        handlerIds.append(handler->id);
+    handlerIds.sort();
+    return searchTerm.simplified().toLower() + QChar('\0') + handlerIds.join(',');
+}
+
+}
+
 /** ***************************************************************************/
 QueryManager::QueryManager(ExtensionManager* em, QObject *parent)
     : QObject(parent),
       extensionManager_(em),
-      currentQuery_(nullptr) {
+      currentQuery_(nullptr),
+      shownQuery_(nullptr),
+      registryChanges_(0),
+      prewarmQuery_(nullptr) {
+
+    // The number of top rows that late results must not displace
+    stableRows_ = QSettings(qApp->applicationName()).value(CFG_STABLE_ROWS, DEF_STABLE_ROWS).toUInt();
+
+    // The number of results asked from each handler
+    wantedResults_ = QSettings(qApp->applicationName()).value(CFG_WANTED_RESULTS, DEF_WANTED_RESULTS).toUInt();
 
-    // Initialize the order
-    Core::MatchCompare::update();
+    // The number of queries whose results are cached (opt-in)
+    resultCacheSize_ = QSettings(qApp->applicationName()).value(CFG_RESULT_CACHE_SIZE, DEF_RESULT_CACHE_SIZE).toUInt();
+
+    // Prewarming runs in a single idle priority thread, the handlers of real
+    // queries must not wait for it
+    prewarmPool_.setMaxThreadCount(1);
+
+    // Cached items belong to the plugins, drop them before a plugin unloads
+    connect(extensionManager_, &ExtensionManager::registryChanged,
+            this, &QueryManager::onRegistryChanged);
+
+    // Load the inputs to prewarm the cache with
+    if ( resultCacheSize_ > 0 )
+        likelyInputs_.setFuture(QtConcurrent::run(loadLikelyInputs, QSqlDatabase::database().databaseName()));
+
+    // Initialize the usage scores
+    Core::FrecencyModel::instance()->load();
+}
+
+
+
+/** ***************************************************************************/
+QueryManager::~QueryManager() {
+    likelyInputs_.waitForFinished();
+
+    // The pooled query models must not outlive the application
+    Query::clearModelPool();
+
+    // Persist the usage scores
+    Core::FrecencyModel::instance()->save();
 }
 
 
@@ -47,8 +139,22 @@ QueryManager::QueryManager(ExtensionManager* em, QObject *parent)
 /** ***************************************************************************/
 void QueryManager::setupSession() {
     // Call all setup routines
-    for (Core::QueryHandler *handler : extensionManager_->objectsByType<Core::QueryHandler>())
+    for (Core::QueryHandler *handler : extensionManager_->queryHandlers())
         handler->setupSession();
+
+    // Triggers may have been changed in the settings
+    extensionManager_->updateTriggers();
+
+    // Run the likely queries before the user types them
+    if ( resultCacheSize_ > 0 && likelyInputs_.isFinished() && !extensionManager_->objects().empty() ) {
+        prewarmTerms_.clear();
+        for ( const QString &input : likelyInputs_.result() ) {
+            for ( const QString &term : { input.left(1), input } )
+                if ( !term.trimmed().isEmpty() && !prewarmTerms_.contains(term) )
+                    prewarmTerms_.append(term);
+        }
+        prewarmNext();
+    }
 }
 
 
@@ -56,41 +162,22 @@ void QueryManager::setupSession() {
 /** ***************************************************************************/
 void QueryManager::teardownSession() {
 
+    // The session is over
+    cancelPrewarming();
+
     // Call all teardown routines
-    for (Core::QueryHandler *handler : extensionManager_->objectsByType<Core::QueryHandler>())
+    for (Core::QueryHandler *handler : extensionManager_->queryHandlers())
         handler->teardownSession();
 
-    // Open database to store the runtimes
-    QSqlDatabase db = QSqlDatabase::database();
-    QSqlQuery sqlQuery;
-    db.transaction();
+    // Delete the queries that are done
+    reclaimQueries();
 
-    // Delete finished queries and prepare sql transaction containing runtimes
-    vector<Query*>::iterator it = pastQueries_.begin();
-    while ( it != pastQueries_.end()){
-        if ( (*it)->state() != Query::State::Running ) {
-
-            // Store the runtimes
-            for ( const std::pair<QString,uint> &handlerRuntime : (*it)->runtimes() ) {
-                sqlQuery.prepare("INSERT INTO runtimes (extensionId, runtime) VALUES (:extensionId, :runtime);");
-                sqlQuery.bindValue(":extensionId", handlerRuntime.first);
-                sqlQuery.bindValue(":runtime", handlerRuntime.second);
-                if (!sqlQuery.exec())
-                    qWarning() << sqlQuery.lastError();
-            }
+    // Snapshot the usage scores, if they changed
+    Core::FrecencyModel::instance()->snapshot();
 
-            // Delete the query
-            (*it)->deleteLater();
-            it = pastQueries_.erase(it);
-        } else
-            ++it;
-    }
-
-    // Finally send the sql transaction
-    db.commit();
-
-    // Compute new match rankings
-    Core::MatchCompare::update();
+    // Update the inputs to prewarm in the next session
+    if ( resultCacheSize_ > 0 && likelyInputs_.isFinished() )
+        likelyInputs_.setFuture(QtConcurrent::run(loadLikelyInputs, QSqlDatabase::database().databaseName()));
 }
 
 
@@ -98,12 +185,16 @@ void QueryManager::teardownSession() {
 /** ***************************************************************************/
 void QueryManager::startQuery(const QString &searchTerm) {
 
+    // Real input preempts the prewarming
+    cancelPrewarming();
+
     if ( currentQuery_ != nullptr ) {
         // Stop last query
-        disconnect(currentQuery_, &Query::resultsReady, this, &QueryManager::resultsReady);
+        disconnect(currentQuery_, &Query::resultsReady, this, nullptr);
         currentQuery_->invalidate();
         // Store for later deletion (listview still has the model)
-        pastQueries_.push_back(currentQuery_);
+        retireQuery(currentQuery_);
+        currentQuery_ = nullptr;
     }
 
     // Do nothing if nothing is loaded
@@ -112,38 +203,198 @@ void QueryManager::startQuery(const QString &searchTerm) {
 
     // Do nothing if query is empty
     if ( searchTerm.trimmed().isEmpty() ) {
-        currentQuery_ = nullptr;
         emit resultsReady(nullptr);
+        shownQuery_ = nullptr;
+        reclaimQueries();
         return;
     }
 
-    // Get fallbacks
-    vector<shared_ptr<Item>> fallbacks;
-    for ( FallbackProvider *extension : extensionManager_->objectsByType<FallbackProvider>() ) {
-        vector<shared_ptr<Item>> && tmpFallbacks = extension->fallbacks(searchTerm);
-        fallbacks.insert(fallbacks.end(),
-                         std::make_move_iterator(tmpFallbacks.begin()),
-                         std::make_move_iterator(tmpFallbacks.end()));
+    // Start query
+    Query *query = createQuery(searchTerm);
+    connect(query, &Query::resultsReady, this, [this, query](QAbstractItemModel *model){
+        emit resultsReady(model);
+        // The view switched models, the former ones can go
+        shownQuery_ = query;
+        reclaimQueries();
+    });
+    currentQuery_ = query;
+    currentQuery_->run();
+}
+
+
+
+/** ***************************************************************************/
+void QueryManager::retireQuery(Query *query) {
+    pastQueries_.push_back(query);
+    // Reclaim it as soon as its handlers finished
+    connect(query, &Query::finished, this, &QueryManager::reclaimQueries, Qt::QueuedConnection);
+    reclaimQueries();
+}
+
+
+
+/** ***************************************************************************/
+void QueryManager::reclaimQueries() {
+
+    // Delete the queries whose handlers finished and that are not shown anymore
+    vector<Query*>::iterator it = pastQueries_.begin();
+    while ( it != pastQueries_.end()){
+        if ( (*it)->state() != Query::State::Running && *it != shownQuery_ ) {
+
+            // Store the runtimes, prewarming runs sequentially at idle priority
+            if ( prewarmQueries_.erase(*it) == 0 )
+                for ( const std::pair<QString,uint> &handlerRuntime : (*it)->runtimes() )
+                    Core::PersistenceThread::instance()->addRuntime(handlerRuntime.first, handlerRuntime.second);
+
+            // Delete the query
+            (*it)->deleteLater();
+            it = pastQueries_.erase(it);
+        } else
+            ++it;
     }
+}
+
+
+
+/** ***************************************************************************/
+Query *QueryManager::createQuery(const QString &searchTerm, bool *cached) {
 
     // Determine query handlers
-    const set<QueryHandler*> allHandlers = extensionManager_->objectsByType<QueryHandler>();
-    set<QueryHandler*> actualHandlers;
-    for ( QueryHandler *handler : allHandlers )
-        if ( !handler->trigger().isEmpty() && searchTerm.startsWith(handler->trigger()) )
-            actualHandlers.insert(handler);
+    const set<QueryHandler*> &actualHandlers = extensionManager_->queryHandlers(searchTerm);
 
-    if (actualHandlers.empty())
-        for ( QueryHandler *handler : allHandlers )
-            if ( handler->trigger().isEmpty() )
-                actualHandlers.insert(handler);
+    Query *query = new Query;
+    query->setSearchTerm(searchTerm);
+    query->setQueryHandlers(actualHandlers);
+    query->setFallbackProviders(extensionManager_->fallbackProviders());
+    query->setWantedCount(wantedResults_);
+    query->setStableRows(stableRows_);
 
+    if ( resultCacheSize_ > 0 ) {
 
-    // Start query
-    currentQuery_ = new Query;
-    connect(currentQuery_, &Query::resultsReady, this, &QueryManager::resultsReady);
-    currentQuery_->setSearchTerm(searchTerm);
-    currentQuery_->setQueryHandlers(actualHandlers);
-    currentQuery_->setFallbacks(fallbacks);
-    currentQuery_->run();
+        // Show the results of a repeated query at once
+        QString key = cacheKey(searchTerm, actualHandlers);
+        const CachedResults *cachedResults = lookupCachedResults(key, actualHandlers);
+        if ( cachedResults )
+            query->setCachedResults(cachedResults->results);
+        if ( cached )
+            *cached = cachedResults != nullptr;
+
+        // Cache the results when the query finished
+        map<QString,uint> generations;
+        for ( QueryHandler *handler : actualHandlers )
+            generations.emplace(handler->id, handler->indexGeneration());
+        uint registryChanges = registryChanges_;
+        connect(query, &Query::finished, this, [this, key, generations, query, registryChanges](){
+            if ( query->isValid() && registryChanges == registryChanges_ )
+                cacheResults(key, generations, query);
+        });
+    }
+
+    return query;
+}
+
+
+
+/** ***************************************************************************/
+void QueryManager::prewarmNext() {
+
+    if ( prewarmQuery_ != nullptr ) {
+        retireQuery(prewarmQuery_);
+        prewarmQuery_ = nullptr;
+    }
+
+    // One query at a time, the user may start typing any moment
+    while ( !prewarmTerms_.isEmpty() ) {
+        bool cached = false;
+        prewarmQuery_ = createQuery(prewarmTerms_.takeFirst(), &cached);
+        if ( cached ) {
+            prewarmQuery_->deleteLater();
+            prewarmQuery_ = nullptr;
+            continue;
+        }
+        prewarmQueries_.insert(prewarmQuery_);
+        prewarmQuery_->setThreadPool(&prewarmPool_);
+        // Its results are only cached, fallbacks are never shown
+        prewarmQuery_->setFallbackProviders({});
+        connect(prewarmQuery_, &Query::finished, this, &QueryManager::prewarmNext, Qt::QueuedConnection);
+        prewarmQuery_->run();
+        return;
+    }
+}
+
+
+
+/** ***************************************************************************/
+void QueryManager::cancelPrewarming() {
+    prewarmTerms_.clear();
+    if ( prewarmQuery_ != nullptr ) {
+        disconnect(prewarmQuery_, &Query::finished, this, &QueryManager::prewarmNext);
+        prewarmQuery_->invalidate();
+        retireQuery(prewarmQuery_);
+        prewarmQuery_ = nullptr;
+    }
+}
+
+
+
+/** ***************************************************************************/
+void QueryManager::onRegistryChanged() {
+    ++registryChanges_;
+    cancelPrewarming();
+    resultCacheIndex_.clear();
+    resultCache_.clear();
+}
+
+
+
+/** ***************************************************************************/
+const QueryManager::CachedResults *QueryManager::lookupCachedResults(const QString &key,
+                                                                    const set<QueryHandler*> &handlers) {
+
+    auto it = resultCacheIndex_.find(key);
+    if ( it == resultCacheIndex_.end() )
+        return nullptr;
+
+    // Invalidate the entry if any of the handlers changed its index
+    for ( QueryHandler *handler : handlers ) {
+        auto generation = it->second->generations.find(handler->id);
+        if ( generation == it->second->generations.end()
+             || generation->second != handler->indexGeneration() ) {
+            resultCache_.erase(it->second);
+            resultCacheIndex_.erase(it);
+            return nullptr;
+        }
+    }
+
+    // Most recently used
+    resultCache_.splice(resultCache_.begin(), resultCache_, it->second);
+    return &resultCache_.front();
+}
+
+
+
+/** ***************************************************************************/
+void QueryManager::cacheResults(const QString &key,
+                                const map<QString,uint> &generations,
+                                Query *query) {
+
+    vector<pair<shared_ptr<Item>,short>> results = query->topResults(CACHED_RESULTS);
+
+    auto it = resultCacheIndex_.find(key);
+    if ( it != resultCacheIndex_.end() ) {
+        resultCache_.erase(it->second);
+        resultCacheIndex_.erase(it);
+    }
+
+    if ( results.empty() )
+        return;
+
+    resultCache_.push_front(CachedResults{key, generations, std::move(results)});
+    resultCacheIndex_.emplace(key, resultCache_.begin());
+
+    // Evict the least recently used
+    while ( resultCache_.size() > resultCacheSize_ ) {
+        resultCacheIndex_.erase(resultCache_.back().key);
+        resultCache_.pop_back();
+    }
 }
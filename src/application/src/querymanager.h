@@ -17,11 +17,20 @@
 #pragma once
 #include <QObject>
 #include <QAbstractItemModel>
+#include <QFutureWatcher>
+#include <QStringList>
+#include <QThreadPool>
+#include <list>
+#include <map>
+#include <memory>
+#include <set>
 #include <vector>
 
 namespace Core {
 class ExtensionManager;
+class Item;
 class Query;
+class QueryHandler;
 }
 
 class QueryManager : public QObject
@@ -31,6 +40,7 @@ class QueryManager : public QObject
 public:
 
     explicit QueryManager(Core::ExtensionManager* em, QObject *parent = 0);
+    ~QueryManager();
 
     void setupSession();
     void teardownSession();
@@ -38,9 +48,38 @@ public:
 
 private:
 
+    /** The results of a former query and the index generations they base on */
+    struct CachedResults {
+        QString key;
+        std::map<QString,uint> generations; // By handler id, pointers die with their plugin
+        std::vector<std::pair<std::shared_ptr<Core::Item>,short>> results;
+    };
+
+    Core::Query *createQuery(const QString &searchTerm, bool *cached = nullptr);
+    void retireQuery(Core::Query *query);
+    void reclaimQueries();
+    void prewarmNext();
+    void cancelPrewarming();
+    void onRegistryChanged();
+
+    const CachedResults *lookupCachedResults(const QString &key, const std::set<Core::QueryHandler*> &handlers);
+    void cacheResults(const QString &key, const std::map<QString,uint> &generations, Core::Query *query);
+
     Core::ExtensionManager *extensionManager_;
     Core::Query *currentQuery_;
+    Core::Query *shownQuery_;
     std::vector<Core::Query*> pastQueries_;
+    uint stableRows_;
+    uint wantedResults_;
+    size_t resultCacheSize_;
+    std::list<CachedResults> resultCache_; // MRU first
+    std::map<QString,std::list<CachedResults>::iterator> resultCacheIndex_;
+    uint registryChanges_; // Queries started before a change are not cached
+    QFutureWatcher<QStringList> likelyInputs_;
+    QStringList prewarmTerms_;
+    Core::Query *prewarmQuery_;
+    std::set<Core::Query*> prewarmQueries_; // Their runtimes are not recorded
+    QThreadPool prewarmPool_;
 
 signals:
 
@@ -22,16 +22,17 @@
 #include <QMessageBox>
 #include <QSettings>
 #include <QShortcut>
-#include <QSqlQuery>
 #include <QStandardPaths>
 #include <vector>
 #include <utility>
 #include "extension.h"
 #include "extensionspec.h"
 #include "extensionmanager.h"
+#include "frecencymodel.h"
 #include "hotkeymanager.h"
 #include "loadermodel.h"
 #include "mainwindow.h"
+#include "persistencethread.h"
 #include "settingswidget.h"
 #include "trayicon.h"
 using Core::Extension;
@@ -194,8 +195,10 @@ SettingsWidget::SettingsWidget(MainWindow *mainWindow,
             this, &SettingsWidget::onThemeChanged);
 
     // Cache
-    connect(ui.pushButton_clearCache, &QPushButton::clicked, [](){
-        QSqlQuery("DELETE FROM usages;");
+    connect(ui.pushButton_clearCache, &QPushButton::clicked, [this](){
+        Core::PersistenceThread::instance()->clearUsages();
+        Core::FrecencyModel::instance()->clear();
+        mainWindow_->clearHistory();
     });
 
 
@@ -29,6 +29,8 @@ namespace Core {
 class Extension;
 class ExtensionSpec;
 class ExtensionManagerPrivate;
+class FallbackProvider;
+class QueryHandler;
 
 class EXPORT_CORE ExtensionManager final : public QObject
 {
@@ -48,7 +50,22 @@ public:
 
     void registerObject(QObject *);
     void unregisterObject(QObject*);
-    const std::set<QObject *> objects() const;
+    const std::set<QObject *> &objects() const;
+
+    /** The registered objects by interface, kept up to date on (un)registering */
+    const std::set<QueryHandler *> &queryHandlers() const;
+    const std::set<FallbackProvider *> &fallbackProviders() const;
+
+    /**
+     * @brief The handlers responsible for the search term
+     * The handlers whose triggers prefix the search term or, if there are none,
+     * the handlers without trigger. Costs a walk of the trigger trie.
+     */
+    const std::set<QueryHandler *> &queryHandlers(const QString &searchTerm) const;
+
+    /** Rebuilds the trigger trie, call this when triggers changed */
+    void updateTriggers();
+
     template <typename T>
     std::set<T *> objectsByType() {
         std::set<T *> results;
@@ -74,6 +91,9 @@ signals:
     void extensionLoaded(Extension*);
     void extensionAboutToUnload(Extension*);
 
+    /** Extensions or objects have been (un)registered, emitted before plugins unload */
+    void registryChanged();
+
 };
 
 }
@@ -0,0 +1,103 @@
+// albert - a simple application launcher for linux
+// Copyright (C) 2014-2016 Manuel Schneider
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+#include <QByteArray>
+#include <QFuture>
+#include <QReadWriteLock>
+#include <QString>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "core_globals.h"
+
+namespace Core {
+
+/**
+ * @brief The FrecencyModel class
+ * Usage scores of the items with exponential time decay. The scores are kept
+ * in log space relative to a fixed epoch. This way decaying all scores is
+ * implicit and recording an activation is a O(1) update. The actual score is
+ * computed lazily when it is read.
+ *
+ * Additionally a prefix tree over the normalized inputs that led to
+ * activations holds the top scored items per input prefix. This allows to rank
+ * items by what the user usually picks for the current input.
+ */
+class EXPORT_CORE FrecencyModel final
+{
+    struct PrefixNode;
+
+public:
+
+    /** The log space scores by item id hash */
+    typedef std::unordered_map<uint64_t, double> Scores;
+
+    ~FrecencyModel();
+
+    static FrecencyModel *instance();
+
+    /** Restores the snapshot, rebuilds it from the usages table on first start */
+    void load();
+
+    /** Writes the snapshot in a background thread, if there are changes */
+    void snapshot();
+
+    /** Writes the snapshot and waits until it is on disk */
+    void save();
+
+    /** Forgets all usages and writes the empty snapshot */
+    void clear();
+
+    /** Records an activation of the item for the given input now */
+    void addUsage(const QString &input, const QString &itemId);
+
+    /** The current time in the log space of the scores */
+    static double now();
+
+    /**
+     * The current scores. The map is never modified, activations replace it.
+     * Hold it for as long as scores are read, e.g. once per query.
+     */
+    std::shared_ptr<const Scores> scores() const;
+
+    /** The decayed score of the item (by id hash) at "now", 0 if it is unused */
+    static double score(const Scores &scores, uint64_t idHash, double now);
+
+    /** The log space scores of the items used most for inputs starting with input */
+    std::vector<std::pair<uint64_t, double>> prefixScores(const QString &input) const;
+
+private:
+
+    FrecencyModel();
+
+    void addUsage(const QString &input, uint64_t idHash, double time);
+    Scores &mutableScores();
+    void prune();
+    QByteArray serialize() const;
+    bool deserialize(const QByteArray &data);
+    static void write(const QByteArray &data);
+
+    mutable QReadWriteLock lock_;
+    std::shared_ptr<Scores> logScores_;
+    std::unique_ptr<PrefixNode> prefixTree_;
+    bool dirty_;
+    QFuture<void> snapshotFuture_;
+};
+
+}
@@ -18,12 +18,11 @@
 #include <QString>
 #include <vector>
 #include <memory>
+#include "action.h"
 #include "core_globals.h"
 
 namespace Core {
 
-class Action;
-
 /** ****************************************************************************
  * @brief The item interface
  * Subclass this class to make your object displayable in the results list.
@@ -60,6 +59,27 @@ public:
     /** The alternative actions of the item*/
     virtual std::vector<std::shared_ptr<Action>> actions() = 0;
 
+    /*
+     * The views use these to not build the actions just to display them.
+     * Override them to build the action objects only on activation.
+     */
+
+    /** The number of actions of the item */
+    virtual size_t actionCount() { return actions().size(); }
+
+    /** The description of the action at index i */
+    virtual QString actionText(size_t i) {
+        std::vector<std::shared_ptr<Action>> actions_ = actions();
+        return (i < actions_.size()) ? actions_[i]->text() : QString();
+    }
+
+    /** Activates the action at index i */
+    virtual void activateAction(size_t i) {
+        std::vector<std::shared_ptr<Action>> actions_ = actions();
+        if (i < actions_.size())
+            actions_[i]->activate();
+    }
+
 };
 
 }
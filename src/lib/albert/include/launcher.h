@@ -0,0 +1,50 @@
+// albert - a simple application launcher for linux
+// Copyright (C) 2014-2016 Manuel Schneider
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+#include <QString>
+#include <QStringList>
+#include "core_globals.h"
+class QUrl;
+
+namespace Core {
+
+/**
+ * @brief The Launcher class
+ * Starts detached processes on a launcher thread, so activating an item never
+ * blocks the GUI. The processes are spawned with posix_spawn in an own
+ * session with default signal handling, instead of forking the whole albert
+ * process like QProcess::startDetached does. The calls return at once,
+ * failures like missing programs are logged.
+ */
+class EXPORT_CORE Launcher final
+{
+public:
+
+    /** Starts the program with the arguments in the working directory */
+    static void startDetached(const QString &program,
+                              const QStringList &arguments = QStringList(),
+                              const QString &workingDirectory = QString());
+
+    /** Starts a command line, split like QProcess::startDetached does */
+    static void startDetached(const QString &commandLine);
+
+    /** Opens the url in the preferred application */
+    static void openUrl(const QUrl &url);
+
+};
+
+}
@@ -16,9 +16,12 @@
 
 #pragma once
 #include <QString>
-#include <map>
+#include <cstdint>
 #include <memory>
+#include <utility>
+#include <vector>
 #include "core_globals.h"
+#include "frecencymodel.h"
 #include "item.h"
 
 namespace Core {
@@ -31,13 +34,54 @@ class EXPORT_CORE MatchCompare
 {
 public:
 
-    static void update();
-    bool operator()(const std::pair<std::shared_ptr<Item>, short>& lhs,
-                    const std::pair<std::shared_ptr<Item>, short>& rhs);
+    /**
+     * The ranking keys of a match. Computed once when the match is added, so
+     * that sorting does not need any virtual calls or lookups.
+     */
+    struct Key {
+        Item::Urgency urgency;
+        double usageScore;
+        short matchScore;
+        uint64_t idHash; // Tie-breaker
+    };
+
+    /** Ranks without usage scores, e.g. for recycled query models */
+    MatchCompare();
+
+    /** Blends in how often items were picked for inputs like this one */
+    explicit MatchCompare(const QString &input);
+
+    /** The hash of an item id, the usage scores are keyed by it */
+    static uint64_t hash(const QString &id);
+
+    /** Computes the ranking keys of an item matched with the given score */
+    Key key(const Item &item, short score) const;
+
+    /** Computes the ranking keys of an item that is not constructed yet */
+    Key key(const QString &id, short score, Item::Urgency urgency = Item::Urgency::Normal) const;
+
+    bool operator()(const Key &lhs, const Key &rhs) const;
+
+    /**
+     * Lets go of the usage scores once all keys are computed. Activations
+     * copy the scores while they are held.
+     */
+    void releaseScores();
+
+    /** Compares anything carrying a member "key" */
+    template<class T>
+    bool operator()(const T &lhs, const T &rhs) const { return (*this)(lhs.key, rhs.key); }
 
 private:
 
-    static std::map<QString, double> order;
+    /** The point in time the usage scores are decayed to */
+    double now_;
+
+    /** The usage scores at construction, read without locking by the handlers. Null if released. */
+    std::shared_ptr<const FrecencyModel::Scores> scores_;
+
+    /** The log space scores of the items used most for the input */
+    std::vector<std::pair<uint64_t, double>> inputScores_;
 };
 
 }
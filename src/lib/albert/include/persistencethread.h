@@ -0,0 +1,80 @@
+// albert - a simple application launcher for linux
+// Copyright (C) 2014-2016 Manuel Schneider
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+#include <QMutex>
+#include <QString>
+#include <QThread>
+#include <QWaitCondition>
+#include <vector>
+#include "core_globals.h"
+class QSqlQuery;
+
+namespace Core {
+
+/**
+ * @brief The PersistenceThread class
+ * Writes to core.db in a dedicated thread using its own connection. The GUI
+ * thread only enqueues the writes. The thread takes whatever is queued and
+ * writes it in a single transaction using cached prepared statements. When
+ * the queue has been idle for a while the thread also maintains the database
+ * (retention, statistics and incremental vacuum).
+ */
+class EXPORT_CORE PersistenceThread final : public QThread
+{
+public:
+
+    static PersistenceThread *instance();
+
+    /** Opens an own connection to the database and starts the thread */
+    void open(const QString &databaseName);
+
+    /** Writes the remaining queue and stops the thread */
+    void shutdown();
+
+    /** Records that the item has been activated for the input */
+    void addUsage(const QString &input, const QString &itemId);
+
+    /** Records the runtime of a query handler */
+    void addRuntime(const QString &extensionId, uint runtime);
+
+    /** Deletes all recorded usages */
+    void clearUsages();
+
+private:
+
+    struct Write {
+        enum class Type { Usage, Runtime, ClearUsages } type;
+        QString first;
+        QString second;
+        uint value;
+        QString timestamp;
+    };
+
+    PersistenceThread();
+
+    void enqueue(Write &&write);
+    void maintain(QSqlQuery &sqlQuery);
+    void run() override;
+
+    QString databaseName_;
+    QMutex mutex_;
+    QWaitCondition condition_;
+    std::vector<Write> queue_;
+    bool stop_;
+};
+
+}
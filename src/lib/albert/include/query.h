@@ -24,11 +24,13 @@
 #include "core_globals.h"
 #include "queryhandler.h"
 
+class QThreadPool;
 class QueryManager;
 
 namespace Core {
 
 class Extension;
+class FallbackProvider;
 class Item;
 
 /**
@@ -61,20 +63,68 @@ public:
     void addMatches(std::vector<std::pair<std::shared_ptr<Item>,short>>::iterator begin,
                     std::vector<std::pair<std::shared_ptr<Item>,short>>::iterator end);
 
+    /**
+     * The number of results the query asks each handler for. Matches a
+     * handler ranks behind this many of its own matches are dropped. When
+     * the user scrolls past the results, the handlers run again with twice
+     * the count.
+     */
+    uint wantedCount() const;
+
+    /**
+     * Tells whether a match of the item with the given id could still make
+     * it into the results. Lets handlers skip building items nobody sees.
+     */
+    bool isWanted(const QString &id, short score = 0) const;
+
     std::map<QString,uint> runtimes();
 
+    /** The microseconds it took until the results were shown first */
+    uint timeToFirstResult() const;
+
+    /** The microseconds the last activated action waited for the frontend to hide */
+    static uint activationDelay();
+
+    /** The microseconds the last activated action took */
+    static uint activationTime();
+
+    /** The number of result batches the handlers handed over */
+    uint batchCount() const;
+
+    /** The number of batch handovers that had to retry due to contention */
+    uint contendedPushes() const;
+
 private:
 
     Query();
     ~Query();
 
+    /** Frees the recycled models, queries deleted afterwards are not recycled */
+    static void clearModelPool();
+
     void setSearchTerm(const QString &);
 
     void invalidate();
 
     void setQueryHandlers(const std::set<QueryHandler*> &);
 
-    void setFallbacks(const std::vector<std::shared_ptr<Item>> &);
+    /** Sets the providers of the fallbacks, they are asked on demand */
+    void setFallbackProviders(const std::set<FallbackProvider*> &);
+
+    /** Sets the number of results asked from each handler */
+    void setWantedCount(uint);
+
+    /** Sets the number of top rows late results must not displace */
+    void setStableRows(uint);
+
+    /** Runs the handlers one after another in the pool, not in the global one */
+    void setThreadPool(QThreadPool *);
+
+    /** Shows results of a former query at once, the handlers confirm them */
+    void setCachedResults(const std::vector<std::pair<std::shared_ptr<Item>,short>> &);
+
+    /** The best results of the handlers, without fallbacks */
+    std::vector<std::pair<std::shared_ptr<Item>,short>> topResults(size_t count) const;
 
     void run();
 
@@ -59,11 +59,19 @@ public:
 
     virtual bool isLongRunning() const { return false; }
 
+    /**
+     * @brief The generation of the index
+     * Results of repeated queries may be cached. Handlers whose results change
+     * over time (e.g. because they rebuilt their index) have to return a
+     * different number whenever that happens to invalidate the cached results.
+     */
+    virtual uint indexGeneration() const { return 0; }
+
     /**
      * @brief Query handling
      * This method is called for every user input. Add the results to the query
-     * passed as parameter. The results are sorted by usage. After 100 ms
-     * they are just appended to not disturb the users interaction. Queries can
+     * passed as parameter. The results are sorted by usage. Late results are
+     * ranked in below the top rows to not disturb the users interaction. Queries can
      * get invalidated so make sure to regularly check isValid() to cancel
      * long running operations. This method is called in a thread without event
      * loop, be aware of the consequences (especially regarding signal/slot
@@ -50,6 +50,10 @@ public:
     std::vector<std::shared_ptr<Action>> actions() override final;
     void setActions(std::vector<std::shared_ptr<Action>> &&actions);
 
+    size_t actionCount() override final;
+    QString actionText(size_t i) override final;
+    void activateAction(size_t i) override final;
+
 private:
 
     QString id_;
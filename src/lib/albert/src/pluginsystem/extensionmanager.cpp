@@ -24,9 +24,13 @@
 #include <QSettings>
 #include <QStandardPaths>
 #include <chrono>
+#include <map>
 #include <memory>
 #include "extensionmanager.h"
 #include "extensionspec.h"
+#include "fallbackprovider.h"
+#include "queryhandler.h"
+using std::map;
 using std::set;
 using std::unique_ptr;
 using std::vector;
@@ -41,10 +45,70 @@ Core::ExtensionManager *Core::ExtensionManager::instance = nullptr;
 /** ***************************************************************************/
 class Core::ExtensionManagerPrivate {
 public:
+
+    // A node of the trigger trie. Holds the handlers of all triggers ending
+    // here or in any ancestor, but only if a trigger ends here.
+    struct TriggerNode {
+        map<QChar, unique_ptr<TriggerNode>> children;
+        set<QueryHandler*> handlers;
+    };
+
     vector<unique_ptr<ExtensionSpec>> extensionSpecs_; // TASK: Rename _
     set<QObject*> extensions_;
     QStringList blacklist_;
     QStringList pluginDirs;
+
+    set<QueryHandler*> queryHandlers;
+    set<QueryHandler*> triggerlessHandlers;
+    set<FallbackProvider*> fallbackProviders;
+    TriggerNode triggerTrie;
+
+
+    /** ***************************************************************************/
+    void updateRegistry() {
+        queryHandlers.clear();
+        fallbackProviders.clear();
+        for (QObject *object : extensions_) {
+            if (QueryHandler *handler = dynamic_cast<QueryHandler*>(object))
+                queryHandlers.insert(handler);
+            if (FallbackProvider *provider = dynamic_cast<FallbackProvider*>(object))
+                fallbackProviders.insert(provider);
+        }
+        updateTriggers();
+    }
+
+
+    /** ***************************************************************************/
+    void updateTriggers() {
+        triggerlessHandlers.clear();
+        triggerTrie.children.clear();
+        for (QueryHandler *handler : queryHandlers) {
+            QString trigger = handler->trigger();
+            if (trigger.isEmpty()) {
+                triggerlessHandlers.insert(handler);
+                continue;
+            }
+            TriggerNode *node = &triggerTrie;
+            for (const QChar &c : trigger) {
+                unique_ptr<TriggerNode> &child = node->children[c];
+                if (!child)
+                    child.reset(new TriggerNode);
+                node = child.get();
+            }
+            node->handlers.insert(handler);
+        }
+        inheritHandlers(&triggerTrie, triggerTrie.handlers);
+    }
+
+
+    /** ***************************************************************************/
+    void inheritHandlers(TriggerNode *node, const set<QueryHandler*> &inherited) {
+        if (!node->handlers.empty())
+            node->handlers.insert(inherited.begin(), inherited.end());
+        const set<QueryHandler*> &handlers = node->handlers.empty() ? inherited : node->handlers;
+        for (auto &child : node->children)
+            inheritHandlers(child.second.get(), handlers);
+    }
 };
 
 
@@ -151,11 +215,47 @@ const vector<unique_ptr<Core::ExtensionSpec>>& Core::ExtensionManager::extension
 
 
 /** ***************************************************************************/
-const set<QObject*> Core::ExtensionManager::objects() const {
+const set<QObject*> &Core::ExtensionManager::objects() const {
     return d->extensions_;
 }
 
 
+/** ***************************************************************************/
+const set<Core::QueryHandler*> &Core::ExtensionManager::queryHandlers() const {
+    return d->queryHandlers;
+}
+
+
+/** ***************************************************************************/
+const set<Core::FallbackProvider*> &Core::ExtensionManager::fallbackProviders() const {
+    return d->fallbackProviders;
+}
+
+
+/** ***************************************************************************/
+const set<Core::QueryHandler*> &Core::ExtensionManager::queryHandlers(const QString &searchTerm) const {
+
+    // Walk down the trie, the deepest trigger node knows all matching handlers
+    const set<QueryHandler*> *handlers = &d->triggerlessHandlers;
+    const ExtensionManagerPrivate::TriggerNode *node = &d->triggerTrie;
+    for (const QChar &c : searchTerm) {
+        auto it = node->children.find(c);
+        if (it == node->children.end())
+            break;
+        node = it->second.get();
+        if (!node->handlers.empty())
+            handlers = &node->handlers;
+    }
+    return *handlers;
+}
+
+
+/** ***************************************************************************/
+void Core::ExtensionManager::updateTriggers() {
+    d->updateTriggers();
+}
+
+
 /** ***************************************************************************/
 void Core::ExtensionManager::loadExtension(const unique_ptr<ExtensionSpec> &spec) {
     if (spec->state() != ExtensionSpec::State::Loaded){
@@ -164,6 +264,8 @@ void Core::ExtensionManager::loadExtension(const unique_ptr<ExtensionSpec> &spec
             auto msecs = std::chrono::duration_cast<std::chrono::milliseconds>(system_clock::now()-start);
             qDebug() << QString("Loading %1 done in %2 milliseconds").arg(spec->id()).arg(msecs.count()).toLocal8Bit().data();
             d->extensions_.insert(spec->instance());
+            d->updateRegistry();
+            emit registryChanged();
         } else
             qDebug() << QString("Loading %1 failed. (%2)").arg(spec->id(), spec->lastError()).toLocal8Bit().data();
     }
@@ -174,6 +276,8 @@ void Core::ExtensionManager::loadExtension(const unique_ptr<ExtensionSpec> &spec
 void Core::ExtensionManager::unloadExtension(const unique_ptr<ExtensionSpec> &spec) {
     if (spec->state() != ExtensionSpec::State::NotLoaded) {
         d->extensions_.erase(spec->instance());
+        d->updateRegistry();
+        emit registryChanged(); // Before the plugin code is unmapped
         spec->unload();
     }
 }
@@ -206,10 +310,14 @@ bool Core::ExtensionManager::extensionIsEnabled(const unique_ptr<ExtensionSpec>
 /** ***************************************************************************/
 void Core::ExtensionManager::registerObject(QObject *object) {
     d->extensions_.insert(object);
+    d->updateRegistry();
+    emit registryChanged();
 }
 
 
 /** ***************************************************************************/
 void Core::ExtensionManager::unregisterObject(QObject *object) {
     d->extensions_.erase(object);
+    d->updateRegistry();
+    emit registryChanged();
 }
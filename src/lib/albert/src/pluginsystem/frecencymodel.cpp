@@ -0,0 +1,375 @@
+// albert - a simple application launcher for linux
+// Copyright (C) 2014-2016 Manuel Schneider
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <QDataStream>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QSaveFile>
+#include <QSqlQuery>
+#include <QStandardPaths>
+#include <QVariant>
+#include <QtConcurrent>
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include "frecencymodel.h"
+#include "matchcompare.h"
+using std::map;
+using std::pair;
+using std::unique_ptr;
+using std::vector;
+
+namespace {
+
+// The time after which a usage counts half
+const double HALF_LIFE_SECS = 14*24*60*60;
+
+// The decay rate per second
+const double LAMBDA = std::log(2.0) / HALF_LIFE_SECS;
+
+// The number of items kept per input prefix
+const size_t TOP_K = 8;
+
+// Scores decayed below this are dropped. A single usage gets there after
+// about 93 days, right after the usages table forgets it.
+const double MIN_SCORE = 0.01;
+
+const quint32 SNAPSHOT_MAGIC = 0xA1BE0002;
+
+QString snapshotPath() {
+    return QDir(QStandardPaths::writableLocation(QStandardPaths::CacheLocation)).filePath("frecency.dat");
+}
+
+QString normalized(const QString &input) {
+    return input.simplified().toLower();
+}
+
+// log(exp(a) + exp(b)) without leaving the log space
+double logAddExp(double a, double b) {
+    double hi = std::max(a, b);
+    double lo = std::min(a, b);
+    return hi + std::log1p(std::exp(lo - hi));
+}
+
+}
+
+
+/** ***************************************************************************/
+struct Core::FrecencyModel::PrefixNode
+{
+    map<QChar, unique_ptr<PrefixNode>> children;
+    vector<pair<uint64_t, double>> top; // (idHash, logScore), at most TOP_K
+
+    void add(uint64_t idHash, double logScore) {
+        vector<pair<uint64_t, double>>::iterator it =
+                std::find_if(top.begin(), top.end(),
+                             [idHash](const pair<uint64_t, double> &entry){ return entry.first == idHash; });
+        if (it != top.end())
+            it->second = logAddExp(it->second, logScore);
+        else if (top.size() < TOP_K)
+            top.emplace_back(idHash, logScore);
+        else {
+            // Replace the weakest entry if the new one is stronger
+            it = std::min_element(top.begin(), top.end(),
+                                  [](const pair<uint64_t, double> &lhs, const pair<uint64_t, double> &rhs){
+                                      return lhs.second < rhs.second;
+                                  });
+            if (it->second < logScore)
+                *it = {idHash, logScore};
+        }
+    }
+
+    // Drops the entries below the minimum, returns true if the node is empty
+    bool prune(double minLogScore) {
+        top.erase(std::remove_if(top.begin(), top.end(),
+                                 [minLogScore](const pair<uint64_t, double> &entry){
+                                     return entry.second < minLogScore;
+                                 }),
+                  top.end());
+        for (map<QChar, unique_ptr<PrefixNode>>::iterator it = children.begin(); it != children.end();)
+            if (it->second->prune(minLogScore))
+                it = children.erase(it);
+            else
+                ++it;
+        return top.empty() && children.empty();
+    }
+
+    void serialize(QDataStream &out) const {
+        out << static_cast<quint32>(top.size());
+        for (const auto &entry : top)
+            out << static_cast<quint64>(entry.first) << entry.second;
+        out << static_cast<quint32>(children.size());
+        for (const auto &child : children) {
+            out << child.first;
+            child.second->serialize(out);
+        }
+    }
+
+    void deserialize(QDataStream &in) {
+        quint32 size;
+        in >> size;
+        for (quint32 i = 0; i < size && in.status() == QDataStream::Ok; ++i) {
+            quint64 idHash;
+            double logScore;
+            in >> idHash >> logScore;
+            top.emplace_back(idHash, logScore);
+        }
+        in >> size;
+        for (quint32 i = 0; i < size && in.status() == QDataStream::Ok; ++i) {
+            QChar c;
+            in >> c;
+            unique_ptr<PrefixNode> &child = children[c];
+            child.reset(new PrefixNode);
+            child->deserialize(in);
+        }
+    }
+};
+
+
+/** ***************************************************************************/
+Core::FrecencyModel::FrecencyModel() : logScores_(new Scores), prefixTree_(new PrefixNode), dirty_(false) {
+
+}
+
+
+/** ***************************************************************************/
+Core::FrecencyModel::~FrecencyModel() {
+
+}
+
+
+/** ***************************************************************************/
+Core::FrecencyModel *Core::FrecencyModel::instance() {
+    static FrecencyModel *instance_ = nullptr;
+    if (!instance_)
+         instance_ = new FrecencyModel();
+    return instance_;
+}
+
+
+/** ***************************************************************************/
+void Core::FrecencyModel::load() {
+
+    QWriteLocker locker(&lock_);
+
+    // Restore the snapshot
+    QFile file(snapshotPath());
+    if (file.open(QIODevice::ReadOnly)) {
+        if (deserialize(file.readAll()))
+            return;
+        qWarning() << "Frecency snapshot outdated or corrupt, rebuilding it from usages.";
+    }
+
+    // First start: Rebuild the scores from the usages table
+    logScores_ = std::make_shared<Scores>();
+    prefixTree_.reset(new PrefixNode);
+    QSqlQuery query;
+    query.exec("SELECT input, itemId, strftime('%s', timestamp) FROM usages");
+    while (query.next())
+        addUsage(query.value(0).toString(),
+                 MatchCompare::hash(query.value(1).toString()),
+                 LAMBDA * query.value(2).toDouble());
+
+    prune();
+    write(serialize());
+    dirty_ = false;
+}
+
+
+/** ***************************************************************************/
+void Core::FrecencyModel::snapshot() {
+
+    if (!dirty_ || snapshotFuture_.isRunning())
+        return;
+
+    // Serializing is a memory operation, do the IO in the background
+    QWriteLocker locker(&lock_);
+    prune();
+    snapshotFuture_ = QtConcurrent::run(&FrecencyModel::write, serialize());
+    dirty_ = false;
+}
+
+
+/** ***************************************************************************/
+void Core::FrecencyModel::save() {
+    snapshotFuture_.waitForFinished();
+    if (dirty_) {
+        QWriteLocker locker(&lock_);
+        prune();
+        write(serialize());
+        dirty_ = false;
+    }
+}
+
+
+/** ***************************************************************************/
+void Core::FrecencyModel::clear() {
+    {
+        QWriteLocker locker(&lock_);
+        logScores_ = std::make_shared<Scores>();
+        prefixTree_.reset(new PrefixNode);
+    }
+    snapshotFuture_.waitForFinished();
+    dirty_ = true;
+    snapshot();
+}
+
+
+/** ***************************************************************************/
+void Core::FrecencyModel::addUsage(const QString &input, const QString &itemId) {
+    QWriteLocker locker(&lock_);
+    addUsage(input, MatchCompare::hash(itemId), now());
+    dirty_ = true;
+}
+
+
+/** ***************************************************************************/
+double Core::FrecencyModel::now() {
+    return LAMBDA * QDateTime::currentMSecsSinceEpoch() / 1000.0;
+}
+
+
+/** ***************************************************************************/
+std::shared_ptr<const Core::FrecencyModel::Scores> Core::FrecencyModel::scores() const {
+    QReadLocker locker(&lock_);
+    return logScores_;
+}
+
+
+/** ***************************************************************************/
+double Core::FrecencyModel::score(const Scores &scores, uint64_t idHash, double now) {
+    Scores::const_iterator it = scores.find(idHash);
+    return (it == scores.cend()) ? 0 : std::exp(it->second - now);
+}
+
+
+/** ***************************************************************************/
+vector<pair<uint64_t, double>> Core::FrecencyModel::prefixScores(const QString &input) const {
+    QReadLocker locker(&lock_);
+    const PrefixNode *node = prefixTree_.get();
+    for (const QChar &c : normalized(input)) {
+        map<QChar, unique_ptr<PrefixNode>>::const_iterator it = node->children.find(c);
+        if (it == node->children.cend())
+            return vector<pair<uint64_t, double>>();
+        node = it->second.get();
+    }
+    return (node == prefixTree_.get()) ? vector<pair<uint64_t, double>>() : node->top;
+}
+
+
+/** ***************************************************************************/
+void Core::FrecencyModel::addUsage(const QString &input, uint64_t idHash, double time) {
+
+    // Global score
+    Scores &scores = mutableScores();
+    Scores::iterator it = scores.find(idHash);
+    if (it == scores.end())
+        scores.emplace(idHash, time);
+    else
+        it->second = logAddExp(it->second, time);
+
+    // Scores of every prefix of the input
+    PrefixNode *node = prefixTree_.get();
+    for (const QChar &c : normalized(input)) {
+        unique_ptr<PrefixNode> &child = node->children[c];
+        if (!child)
+            child.reset(new PrefixNode);
+        node = child.get();
+        node->add(idHash, time);
+    }
+}
+
+
+/** ***************************************************************************/
+Core::FrecencyModel::Scores &Core::FrecencyModel::mutableScores() {
+    // Copy on write, queries may still read the current scores
+    if (logScores_.use_count() > 1)
+        logScores_ = std::make_shared<Scores>(*logScores_);
+    return *logScores_;
+}
+
+
+/** ***************************************************************************/
+void Core::FrecencyModel::prune() {
+
+    // Without pruning every item and input ever used would be kept forever
+    double minLogScore = now() + std::log(MIN_SCORE);
+
+    if (std::any_of(logScores_->cbegin(), logScores_->cend(),
+                    [minLogScore](const pair<const uint64_t, double> &entry){ return entry.second < minLogScore; })) {
+        Scores &scores = mutableScores();
+        for (Scores::iterator it = scores.begin(); it != scores.end();)
+            if (it->second < minLogScore)
+                it = scores.erase(it);
+            else
+                ++it;
+    }
+
+    prefixTree_->prune(minLogScore);
+}
+
+
+/** ***************************************************************************/
+QByteArray Core::FrecencyModel::serialize() const {
+    QByteArray data;
+    QDataStream out(&data, QIODevice::WriteOnly);
+    out << SNAPSHOT_MAGIC << static_cast<quint64>(logScores_->size());
+    for (const auto &entry : *logScores_)
+        out << static_cast<quint64>(entry.first) << entry.second;
+    prefixTree_->serialize(out);
+    return data;
+}
+
+
+/** ***************************************************************************/
+bool Core::FrecencyModel::deserialize(const QByteArray &data) {
+    QDataStream in(data);
+    quint32 magic;
+    quint64 size;
+    in >> magic >> size;
+    if (magic != SNAPSHOT_MAGIC)
+        return false;
+
+    logScores_ = std::make_shared<Scores>();
+    logScores_->reserve(size);
+    for (quint64 i = 0; i < size && in.status() == QDataStream::Ok; ++i) {
+        quint64 idHash;
+        double logScore;
+        in >> idHash >> logScore;
+        logScores_->emplace(idHash, logScore);
+    }
+
+    prefixTree_.reset(new PrefixNode);
+    prefixTree_->deserialize(in);
+
+    return in.status() == QDataStream::Ok;
+}
+
+
+/** ***************************************************************************/
+void Core::FrecencyModel::write(const QByteArray &data) {
+    // Write atomically, a crash must not leave a truncated snapshot
+    QSaveFile file(snapshotPath());
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << qPrintable(QString("Could not write file %1: %2").arg(file.fileName(), file.errorString()));
+        return;
+    }
+    file.write(data);
+    if (!file.commit())
+        qWarning() << qPrintable(QString("Could not write file %1: %2").arg(file.fileName(), file.errorString()));
+}
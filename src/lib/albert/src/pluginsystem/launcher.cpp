@@ -0,0 +1,220 @@
+// albert - a simple application launcher for linux
+// Copyright (C) 2014-2016 Manuel Schneider
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <QByteArray>
+#include <QDebug>
+#include <QDesktopServices>
+#include <QProcess>
+#include <QThreadPool>
+#include <QUrl>
+#include <QtConcurrent>
+#include <algorithm>
+#include <vector>
+#include "launcher.h"
+#ifdef Q_OS_UNIX
+#include <csignal>
+#include <spawn.h>
+#include <string.h>
+#include <sys/wait.h>
+extern char **environ;
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 29))
+#define HAVE_SPAWN_CHDIR
+#endif
+#endif
+using std::vector;
+
+namespace {
+
+// Launches run one after another, in the order of activation
+QThreadPool *launcherPool() {
+    static QThreadPool *pool = [](){
+        QThreadPool *pool = new QThreadPool;
+        pool->setMaxThreadCount(1);
+        return pool;
+    }();
+    return pool;
+}
+
+#ifdef Q_OS_UNIX
+
+// The environment of albert, copied once instead of on every launch
+struct Environment {
+    vector<QByteArray> variables;
+    vector<char*> pointers;
+};
+
+const Environment &environment() {
+    static Environment env = [](){
+        Environment env;
+        for ( char **variable = environ; *variable != nullptr; ++variable )
+            env.variables.emplace_back(*variable);
+        for ( QByteArray &variable : env.variables )
+            env.pointers.push_back(variable.data());
+        env.pointers.push_back(nullptr);
+        return env;
+    }();
+    return env;
+}
+
+// The programs started and not reaped yet, used by the launcher thread only
+vector<pid_t> &children() {
+    static vector<pid_t> children_;
+    return children_;
+}
+
+void reapChildren() {
+    vector<pid_t> &pids = children();
+    pids.erase(std::remove_if(pids.begin(), pids.end(),
+                              [](pid_t pid){ return waitpid(pid, nullptr, WNOHANG) != 0; }),
+               pids.end());
+}
+
+void spawn(const QString &program, const QStringList &arguments, const QString &workingDirectory) {
+
+    // Exited programs are reaped on the next launch
+    reapChildren();
+
+#ifndef HAVE_SPAWN_CHDIR
+    // No way to change the directory of a spawned process
+    if ( !workingDirectory.isEmpty() ) {
+        if ( !QProcess::startDetached(program, arguments, workingDirectory) )
+            qWarning() << qPrintable(QString("Could not start %1 in '%2'").arg(program, workingDirectory));
+        return;
+    }
+#endif
+
+    vector<QByteArray> argv = { program.toLocal8Bit() };
+    for ( const QString &argument : arguments )
+        argv.push_back(argument.toLocal8Bit());
+    vector<char*> pointers;
+    for ( QByteArray &argument : argv )
+        pointers.push_back(argument.data());
+    pointers.push_back(nullptr);
+
+    // The program gets default signal handling and an own session, like it
+    // was started from a terminal and detached
+    posix_spawnattr_t attributes;
+    posix_spawnattr_init(&attributes);
+    sigset_t defaultSignals;
+    sigemptyset(&defaultSignals);
+    sigaddset(&defaultSignals, SIGINT);
+    sigaddset(&defaultSignals, SIGQUIT);
+    sigaddset(&defaultSignals, SIGPIPE);
+    sigaddset(&defaultSignals, SIGCHLD);
+    posix_spawnattr_setsigdefault(&attributes, &defaultSignals);
+    sigset_t mask;
+    sigemptyset(&mask);
+    posix_spawnattr_setsigmask(&attributes, &mask);
+    short flags = POSIX_SPAWN_SETSIGDEF | POSIX_SPAWN_SETSIGMASK;
+#ifdef POSIX_SPAWN_SETSID
+    flags |= POSIX_SPAWN_SETSID;
+#endif
+    posix_spawnattr_setflags(&attributes, flags);
+
+    posix_spawn_file_actions_t fileActions;
+    posix_spawn_file_actions_init(&fileActions);
+#ifdef HAVE_SPAWN_CHDIR
+    QByteArray directory = workingDirectory.toLocal8Bit();
+    if ( !directory.isEmpty() )
+        posix_spawn_file_actions_addchdir_np(&fileActions, directory.constData());
+#endif
+
+    // Without a shell in between the errors of exec are reported here
+    pid_t pid;
+    int error = posix_spawnp(&pid, argv.front().constData(), &fileActions, &attributes,
+                             pointers.data(), environment().pointers.data());
+    posix_spawn_file_actions_destroy(&fileActions);
+    posix_spawnattr_destroy(&attributes);
+
+    if ( error != 0 )
+        qWarning() << qPrintable(QString("Could not start %1: %2").arg(program, strerror(error)));
+    else
+        children().push_back(pid);
+}
+
+#else
+
+void spawn(const QString &program, const QStringList &arguments, const QString &workingDirectory) {
+    if ( !QProcess::startDetached(program, arguments, workingDirectory) )
+        qWarning() << qPrintable(QString("Could not start %1").arg(program));
+}
+
+#endif
+
+// Splits a command line like QProcess does: quotes group, tripled quotes escape
+QStringList splitCommandLine(const QString &commandLine) {
+    QStringList arguments;
+    QString argument;
+    int quoteCount = 0;
+    bool inQuote = false;
+    for ( const QChar &c : commandLine ) {
+        if ( c == '"' ) {
+            ++quoteCount;
+            if ( quoteCount == 3 ) {
+                quoteCount = 0;
+                argument += c;
+            }
+            continue;
+        }
+        if ( quoteCount ) {
+            if ( quoteCount == 1 )
+                inQuote = !inQuote;
+            quoteCount = 0;
+        }
+        if ( !inQuote && c.isSpace() ) {
+            if ( !argument.isEmpty() ) {
+                arguments.append(argument);
+                argument.clear();
+            }
+        } else
+            argument += c;
+    }
+    if ( !argument.isEmpty() )
+        arguments.append(argument);
+    return arguments;
+}
+
+}
+
+
+/** ***************************************************************************/
+void Core::Launcher::startDetached(const QString &program, const QStringList &arguments, const QString &workingDirectory) {
+#ifdef Q_OS_UNIX
+    environment(); // Copied in the calling thread
+#endif
+    QtConcurrent::run(launcherPool(), spawn, program, arguments, workingDirectory);
+}
+
+
+/** ***************************************************************************/
+void Core::Launcher::startDetached(const QString &commandLine) {
+    QStringList arguments = splitCommandLine(commandLine);
+    if ( arguments.isEmpty() )
+        return;
+    QString program = arguments.takeFirst();
+    startDetached(program, arguments);
+}
+
+
+/** ***************************************************************************/
+void Core::Launcher::openUrl(const QUrl &url) {
+#ifdef Q_OS_LINUX
+    // This is what the desktop services do on generic unix, without blocking
+    startDetached("xdg-open", {url.toString(QUrl::FullyEncoded)});
+#else
+    QDesktopServices::openUrl(url);
+#endif
+}
@@ -14,53 +14,86 @@
 // You should have received a copy of the GNU General Public License
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
-#include <QSqlQuery>
-#include <QSqlRecord>
-#include <QSqlError>
-#include <QVariant>
+#include <cmath>
+#include "frecencymodel.h"
 #include "item.h"
 #include "matchcompare.h"
 using namespace std;
 
+namespace {
+
+// The weight of the input specific usage score relative to the global one
+const double INPUT_SCORE_WEIGHT = 2.0;
+
+}
 
 /** ***************************************************************************/
-map<QString, double> Core::MatchCompare::order;
+Core::MatchCompare::MatchCompare() : now_(FrecencyModel::now()) {
+
+}
+
 
 /** ***************************************************************************/
-bool Core::MatchCompare::operator()(const pair<shared_ptr<Item>, short> &lhs,
-                                  const pair<shared_ptr<Item>, short> &rhs) {
+Core::MatchCompare::MatchCompare(const QString &input)
+    : now_(FrecencyModel::now()),
+      scores_(FrecencyModel::instance()->scores()),
+      inputScores_(FrecencyModel::instance()->prefixScores(input)) {
+
+}
+
+
+/** ***************************************************************************/
+uint64_t Core::MatchCompare::hash(const QString &id) {
+    // FNV-1a over the UTF-16 code units
+    uint64_t h = 14695981039346656037ULL;
+    for (const QChar &c : id) {
+        h ^= c.unicode();
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+
+/** ***************************************************************************/
+Core::MatchCompare::Key Core::MatchCompare::key(const Item &item, short score) const {
+    return key(item.id(), score, item.urgency());
+}
+
+
+/** ***************************************************************************/
+Core::MatchCompare::Key Core::MatchCompare::key(const QString &id, short score, Item::Urgency urgency) const {
+    Key key;
+    key.urgency = urgency;
+    key.matchScore = score;
+    key.idHash = hash(id);
+    key.usageScore = scores_ ? FrecencyModel::score(*scores_, key.idHash, now_) : 0;
+    for (const pair<uint64_t, double> &inputScore : inputScores_)
+        if (inputScore.first == key.idHash)
+            key.usageScore += INPUT_SCORE_WEIGHT * std::exp(inputScore.second - now_);
+    return key;
+}
+
+
+/** ***************************************************************************/
+bool Core::MatchCompare::operator()(const Key &lhs, const Key &rhs) const {
     // Compare urgency
-    if (lhs.first->urgency() != rhs.first->urgency())
-        return lhs.first->urgency() > rhs.first->urgency();
+    if (lhs.urgency != rhs.urgency)
+        return lhs.urgency > rhs.urgency;
 
     // Compare usage scores
-    const map<QString,double>::iterator &lit = order.find(lhs.first->id());
-    const map<QString,double>::iterator &rit = order.find(rhs.first->id());
-    if (lit==order.cend()) // |- lhs zero
-        if (rit==order.cend()) // |- rhs zero
-            return lhs.second > rhs.second; // Compare match score
-        else // |- rhs > 0
-            return false; // lhs==0 && rhs>0 implies lhs<rhs implies !(lhs>rhs)
-    else
-        if (rit==order.cend())
-            return true; // lhs>0 && rhs=0 implies lhs>rhs
-        else
-            return lit->second > rit->second; // Both usage scores available, return lhs>rhs
+    if (lhs.usageScore != rhs.usageScore)
+        return lhs.usageScore > rhs.usageScore;
+
+    // Compare match scores
+    if (lhs.matchScore != rhs.matchScore)
+        return lhs.matchScore > rhs.matchScore;
+
+    // Make the order deterministic
+    return lhs.idHash < rhs.idHash;
 }
 
 
 /** ***************************************************************************/
-void Core::MatchCompare::update() {
-    order.clear();
-
-    // Update the results ranking
-    QSqlQuery query;
-    query.exec("SELECT t.itemId AS id, SUM(t.score) AS usageScore "
-               "FROM ( "
-               " SELECT itemId, 1/max(julianday('now')-julianday(timestamp),1) AS score from usages "
-               ") t "
-               "GROUP BY t.itemId");
-    while (query.next())
-        MatchCompare::order.emplace(query.value(0).toString(),
-                                    query.value(1).toDouble());
+void Core::MatchCompare::releaseScores() {
+    scores_.reset();
 }
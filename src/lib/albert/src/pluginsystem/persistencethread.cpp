@@ -0,0 +1,227 @@
+// albert - a simple application launcher for linux
+// Copyright (C) 2014-2016 Manuel Schneider
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <QDateTime>
+#include <QDebug>
+#include <QSqlDatabase>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QVariant>
+#include <algorithm>
+#include <chrono>
+#include "persistencethread.h"
+using std::vector;
+using namespace std::chrono;
+
+namespace {
+
+const char* CONNECTION_NAME = "persistence";
+
+// Maintenance runs after this idle time once per interval
+const seconds MAINTENANCE_IDLE_TIME(60);
+const hours MAINTENANCE_INTERVAL(24);
+
+// The format of sqlites CURRENT_TIMESTAMP (UTC)
+QString currentTimestamp() {
+    return QDateTime::currentDateTimeUtc().toString("yyyy-MM-dd hh:mm:ss");
+}
+
+}
+
+
+/** ***************************************************************************/
+Core::PersistenceThread::PersistenceThread() : stop_(false) {
+    setObjectName("persistence");
+}
+
+
+/** ***************************************************************************/
+Core::PersistenceThread *Core::PersistenceThread::instance() {
+    static PersistenceThread *instance_ = nullptr;
+    if (!instance_)
+         instance_ = new PersistenceThread();
+    return instance_;
+}
+
+
+/** ***************************************************************************/
+void Core::PersistenceThread::open(const QString &databaseName) {
+    if (isRunning())
+        return;
+    databaseName_ = databaseName;
+    stop_ = false;
+    start(QThread::LowPriority);
+}
+
+
+/** ***************************************************************************/
+void Core::PersistenceThread::shutdown() {
+    {
+        QMutexLocker locker(&mutex_);
+        stop_ = true;
+        condition_.wakeOne();
+    }
+    wait();
+}
+
+
+/** ***************************************************************************/
+void Core::PersistenceThread::addUsage(const QString &input, const QString &itemId) {
+    enqueue(Write{Write::Type::Usage, input, itemId, 0, currentTimestamp()});
+}
+
+
+/** ***************************************************************************/
+void Core::PersistenceThread::addRuntime(const QString &extensionId, uint runtime) {
+    enqueue(Write{Write::Type::Runtime, extensionId, QString(), runtime, currentTimestamp()});
+}
+
+
+/** ***************************************************************************/
+void Core::PersistenceThread::clearUsages() {
+    enqueue(Write{Write::Type::ClearUsages, QString(), QString(), 0, QString()});
+}
+
+
+/** ***************************************************************************/
+void Core::PersistenceThread::enqueue(Write &&write) {
+    QMutexLocker locker(&mutex_);
+    queue_.push_back(std::move(write));
+    condition_.wakeOne();
+}
+
+
+/** ***************************************************************************/
+void Core::PersistenceThread::run() {
+
+    {
+        QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", CONNECTION_NAME);
+        db.setDatabaseName(databaseName_);
+        if (!db.open()) {
+            qWarning() << "Persistence thread could not open the database:" << db.lastError();
+            return;
+        }
+
+        // Writers do not block readers and commits are cheap in WAL mode
+        QSqlQuery sqlQuery(db);
+        if (!sqlQuery.exec("PRAGMA journal_mode=WAL;"))
+            qWarning() << sqlQuery.lastError();
+        if (!sqlQuery.exec("PRAGMA synchronous=NORMAL;"))
+            qWarning() << sqlQuery.lastError();
+
+        // Prepare the statements once
+        QSqlQuery insertUsage(db);
+        insertUsage.prepare("INSERT INTO usages (input, itemId, timestamp) VALUES (:input, :itemId, :timestamp);");
+        QSqlQuery insertRuntime(db);
+        insertRuntime.prepare("INSERT INTO runtimes (extensionId, runtime, timestamp) VALUES (:extensionId, :runtime, :timestamp);");
+
+        vector<Write> batch;
+        steady_clock::time_point nextMaintenance = steady_clock::now() + MAINTENANCE_IDLE_TIME;
+        forever {
+
+            // Take everything that is queued
+            {
+                QMutexLocker locker(&mutex_);
+                while (queue_.empty() && !stop_) {
+                    steady_clock::time_point now = steady_clock::now();
+                    if (nextMaintenance <= now)
+                        break;
+                    condition_.wait(&mutex_, static_cast<unsigned long>(
+                                        duration_cast<milliseconds>(nextMaintenance - now).count()) + 1);
+                }
+                if (queue_.empty() && stop_)
+                    break; // Stopped and flushed
+                batch.swap(queue_);
+            }
+
+            // Idle for long enough
+            if (batch.empty()) {
+                maintain(sqlQuery);
+                nextMaintenance = steady_clock::now() + MAINTENANCE_INTERVAL;
+                continue;
+            }
+
+            // Write it in a single transaction
+            db.transaction();
+            for (const Write &write : batch) {
+                switch (write.type) {
+                case Write::Type::Usage:
+                    insertUsage.bindValue(":input", write.first);
+                    insertUsage.bindValue(":itemId", write.second);
+                    insertUsage.bindValue(":timestamp", write.timestamp);
+                    if (!insertUsage.exec())
+                        qWarning() << insertUsage.lastError();
+                    break;
+                case Write::Type::Runtime:
+                    insertRuntime.bindValue(":extensionId", write.first);
+                    insertRuntime.bindValue(":runtime", write.value);
+                    insertRuntime.bindValue(":timestamp", write.timestamp);
+                    if (!insertRuntime.exec())
+                        qWarning() << insertRuntime.lastError();
+                    break;
+                case Write::Type::ClearUsages:
+                    if (!sqlQuery.exec("DELETE FROM usages;"))
+                        qWarning() << "Unable to clear usages table:" << sqlQuery.lastError();
+                    break;
+                }
+            }
+            if (!db.commit())
+                qWarning() << db.lastError();
+
+            batch.clear();
+
+            // Postpone the maintenance while there is activity
+            nextMaintenance = std::max(nextMaintenance, steady_clock::now() + MAINTENANCE_IDLE_TIME);
+        }
+    }
+
+    QSqlDatabase::removeDatabase(CONNECTION_NAME);
+}
+
+
+/** ***************************************************************************/
+void Core::PersistenceThread::maintain(QSqlQuery &sqlQuery) {
+
+    system_clock::time_point start = system_clock::now();
+
+    // Retention, using the timestamp indexes
+    if (!sqlQuery.exec("DELETE FROM usages WHERE timestamp < datetime('now', '-90 days');"))
+        qWarning() << "Unable to cleanup usages table:" << sqlQuery.lastError();
+    if (!sqlQuery.exec("DELETE FROM runtimes WHERE timestamp < datetime('now', '-7 days');"))
+        qWarning() << "Unable to cleanup runtimes table:" << sqlQuery.lastError();
+
+    // Keep the query planner statistics current
+    if (!sqlQuery.exec("ANALYZE;"))
+        qWarning() << sqlQuery.lastError();
+
+    // Return free pages. Databases created without incremental auto vacuum
+    // have to be converted once by a full vacuum.
+    int autoVacuum = 0;
+    if (sqlQuery.exec("PRAGMA auto_vacuum;") && sqlQuery.next())
+        autoVacuum = sqlQuery.value(0).toInt();
+    sqlQuery.finish();
+    if (autoVacuum != 2) {
+        if (!sqlQuery.exec("PRAGMA auto_vacuum=INCREMENTAL;") || !sqlQuery.exec("VACUUM;"))
+            qWarning() << "Unable to enable incremental vacuum:" << sqlQuery.lastError();
+    } else if (sqlQuery.exec("PRAGMA incremental_vacuum;")) {
+        while (sqlQuery.next()); // Frees pages while stepping
+    } else
+        qWarning() << sqlQuery.lastError();
+    sqlQuery.finish();
+
+    qDebug() << "Database maintenance took"
+             << duration_cast<milliseconds>(system_clock::now()-start).count() << "ms";
+}
@@ -14,64 +14,233 @@
 // You should have received a copy of the GNU General Public License
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
-#include <QDebug>
+#include <QCoreApplication>
+#include <QFutureInterface>
 #include <QFutureWatcher>
-#include <QMutex>
-#include <QSqlQuery>
-#include <QSqlRecord>
-#include <QSqlError>
 #include <QString>
+#include <QThreadPool>
 #include <QtConcurrent>
 #include <QTimer>
 #include <QVariant>
 #include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <cstdint>
 #include <map>
 #include <functional>
+#include <unordered_set>
 #include "action.h"
 #include "extension.h"
+#include "fallbackprovider.h"
+#include "frecencymodel.h"
 #include "item.h"
 #include "matchcompare.h"
+#include "persistencethread.h"
 #include "query.h"
 using std::chrono::system_clock;
 using namespace std;
 
+namespace {
+
+// The time after which the results available so far get displayed (~1 frame)
+const int FIRST_PAINT_DEADLINE = 16;
+
+// The interval in which long running handlers hand over their matches
+const int STAGING_INTERVAL = 10;
+
+// The number of finished query models kept for reuse
+const size_t POOL_SIZE = 4;
+
+// The number of rows the model exposes up front and per fetch
+const size_t PAGE_SIZE = 50;
+
+// The number of results a query asks each handler for by default
+const uint WANTED_COUNT = 2 * PAGE_SIZE;
+
+// The number of action texts kept in the display snapshot (modifier actions)
+const size_t SNAPSHOT_ACTIONS = 4;
+
+// The timing of the last activation in microseconds, GUI thread only
+uint lastActivationDelay = 0;
+uint lastActivationTime = 0;
+
+// What the view displays of an item, captured once
+struct Display {
+    QString text;
+    QString subtext;
+    QString iconPath;
+    QString actionTexts[SNAPSHOT_ACTIONS];
+};
+
+// A match, its precomputed ranking keys and its display snapshot
+struct Match {
+    Match(shared_ptr<Core::Item> item, Core::MatchCompare::Key key) : item(std::move(item)), key(key) {}
+    shared_ptr<Core::Item> item;
+    Core::MatchCompare::Key key;
+    mutable unique_ptr<Display> display; // Captured when the row is displayed first
+};
+
+// The matches the handler running in this thread added to a query
+struct StagingBuffer {
+    const void *query = nullptr;
+    bool streaming = false;
+    system_clock::time_point lastFlush;
+    vector<Match> matches;
+    vector<Core::MatchCompare::Key> best; // Heap of the best keys, the worst on top
+};
+thread_local StagingBuffer stagingBuffer;
+
+// A sorted batch of matches in the lock-free pending results stack
+struct Batch {
+    vector<Match> matches;
+    Batch *next;
+};
+
+}
+
 
 /** ***************************************************************************/
 class Core::Query::QueryPrivate : public QAbstractListModel
 {
 public:
-    QueryPrivate(Query *q) : q(q), isValid(true), state(State::Idle) { }
+    QueryPrivate(Query *q)
+        : q(q), isValid(true), state(State::Idle), wantedCount(WANTED_COUNT), threadPool(nullptr), visibleRows(0), stableRows(0),
+          fallbacksComputed(false), fallbacksShown(false), resultsShown(false), timeToFirstResult(0),
+          pendingBatches(nullptr), batchCount(0), contendedPushes(0), matchesDropped(false), fetchPending(false) { }
+
+    ~QueryPrivate() {
+        // Free the batches nobody took
+        takeBatches();
+    }
 
     Query *q;
 
     QString searchTerm;
+    QString altActionText;
     bool isValid;
     Query::State state;
+    uint wantedCount;
+    QThreadPool *threadPool;
 
     set<QueryHandler*> syncHandlers;
     set<QueryHandler*> asyncHandlers;
     map<QString,uint> runtimes;
 
-    vector<shared_ptr<Item>> results;
+    MatchCompare compare;
+    vector<Match> results; // All ranked matches, the first visibleRows are exposed
+    size_t visibleRows;
+    set<FallbackProvider*> fallbackProviders;
     vector<shared_ptr<Item>> fallbacks;
+    uint stableRows;
+    bool fallbacksComputed;
+    bool fallbacksShown;
+    unordered_set<uint64_t> unconfirmed; // Cached results no handler returned yet
 
     QTimer fiftyMsTimer;
-    mutable QMutex pendingResultsMutex;
-    vector<pair<shared_ptr<Item>, short>> pendingResults;
+    QTimer firstPaintTimer;
+    bool resultsShown;
+    system_clock::time_point startTime;
+    uint timeToFirstResult;
+    std::atomic<Batch*> pendingBatches;
+    std::atomic<uint> batchCount;
+    std::atomic<uint> contendedPushes;
+    std::atomic<bool> matchesDropped; // Handlers had more than wantedCount matches
+    bool fetchPending; // The handlers run again for the next page
 
     QFutureWatcher<pair<QueryHandler*,uint>> futureWatcher;
 
 
 
 
+    /** ***************************************************************************/
+    static vector<unique_ptr<QueryPrivate>> &pool() {
+        static vector<unique_ptr<QueryPrivate>> pool_;
+        return pool_;
+    }
+
+
+    /** ***************************************************************************/
+    static bool &poolClosed() {
+        static bool poolClosed_ = false;
+        return poolClosed_;
+    }
+
+
+    /** ***************************************************************************/
+    static unique_ptr<QueryPrivate> acquire(Query *q) {
+        if ( pool().empty() )
+            return unique_ptr<QueryPrivate>(new QueryPrivate(q));
+        unique_ptr<QueryPrivate> d = std::move(pool().back());
+        pool().pop_back();
+        d->q = q;
+        return d;
+    }
+
+
+    /** ***************************************************************************/
+    static void release(unique_ptr<QueryPrivate> &&d) {
+        if ( !poolClosed() && pool().size() < POOL_SIZE ) {
+            d->reset();
+            pool().push_back(std::move(d));
+        }
+    }
+
+
+    /** ***************************************************************************/
+    void reset() {
+
+        // Release the items, but keep the capacity of the vectors
+        beginResetModel();
+        results.clear();
+        visibleRows = 0;
+        endResetModel();
+        fallbacks.clear();
+        unconfirmed.clear();
+        takeBatches();
+
+        q = nullptr;
+        searchTerm.clear();
+        altActionText.clear();
+        isValid = true;
+        state = State::Idle;
+        wantedCount = WANTED_COUNT;
+        threadPool = nullptr;
+        syncHandlers.clear();
+        asyncHandlers.clear();
+        runtimes.clear();
+        compare = MatchCompare();
+        fallbackProviders.clear();
+        stableRows = 0;
+        fallbacksComputed = false;
+        fallbacksShown = false;
+        fiftyMsTimer.stop();
+        fiftyMsTimer.disconnect();
+        firstPaintTimer.stop();
+        firstPaintTimer.disconnect();
+        resultsShown = false;
+        timeToFirstResult = 0;
+        batchCount = 0;
+        contendedPushes = 0;
+        matchesDropped = false;
+        fetchPending = false;
+        futureWatcher.disconnect();
+    }
+
+
     /** ***************************************************************************/
     void run() {
 
+        startTime = system_clock::now();
+
+        // Cached results do not have to wait for the handlers
+        if ( !results.empty() )
+            showResults();
+
         if ( !syncHandlers.empty() )
             return runSyncHandlers();
 
-        emit q->resultsReady(this);
+        if ( !resultsShown )
+            showResults();
 
         if ( !asyncHandlers.empty() )
             return runAsyncHandlers();
@@ -83,13 +252,99 @@ public:
 
     /** ***************************************************************************/
     pair<QueryHandler*,uint> mappedFunction (QueryHandler* queryHandler) {
+
+        // Stage the matches of this handler in a thread local buffer
+        stagingBuffer.query = this;
+        stagingBuffer.streaming = queryHandler->isLongRunning();
+        stagingBuffer.lastFlush = system_clock::now();
+        stagingBuffer.best.clear();
+
         system_clock::time_point then = system_clock::now();
         queryHandler->handleQuery(q);
         system_clock::time_point now = system_clock::now();
+
+        flushStagingBuffer();
+        stagingBuffer.query = nullptr;
+
         return std::make_pair(queryHandler, std::chrono::duration_cast<std::chrono::microseconds>(now-then).count());
     }
 
 
+    /** ***************************************************************************/
+    void flushStagingBuffer() {
+        if ( !stagingBuffer.matches.empty() ) {
+            pushBatch(std::move(stagingBuffer.matches));
+            stagingBuffer.matches.clear();
+        }
+        stagingBuffer.lastFlush = system_clock::now();
+    }
+
+
+    /** ***************************************************************************/
+    bool isCompetitive(const MatchCompare::Key &key) const {
+        // Anything the handler ranks behind wantedCount of its own matches can
+        // not make it into the top wantedCount of the query
+        return stagingBuffer.best.size() < wantedCount || compare(key, stagingBuffer.best.front());
+    }
+
+
+    /** ***************************************************************************/
+    bool admit(const MatchCompare::Key &key) {
+
+        if ( !isCompetitive(key) ) {
+            matchesDropped = true;
+            return false;
+        }
+
+        // Raise the score floor of the handler
+        auto worse = [this](const MatchCompare::Key &lhs, const MatchCompare::Key &rhs){ return compare(lhs, rhs); };
+        vector<MatchCompare::Key> &best = stagingBuffer.best;
+        if ( best.size() == wantedCount ) {
+            std::pop_heap(best.begin(), best.end(), worse);
+            best.back() = key;
+        } else
+            best.push_back(key);
+        std::push_heap(best.begin(), best.end(), worse);
+        return true;
+    }
+
+
+    /** ***************************************************************************/
+    void pushBatch(vector<Match> &&matches) {
+
+        // Sort in the producing thread, the GUI thread just merges
+        std::sort(matches.begin(), matches.end(), compare);
+
+        // Lock-free push onto the stack of pending batches
+        Batch *batch = new Batch{std::move(matches), pendingBatches.load(std::memory_order_relaxed)};
+        while ( !pendingBatches.compare_exchange_weak(batch->next, batch,
+                                                      std::memory_order_release,
+                                                      std::memory_order_relaxed) )
+            ++contendedPushes;
+        ++batchCount;
+    }
+
+
+    /** ***************************************************************************/
+    vector<vector<Match>> takeBatches() {
+
+        // Take the whole stack at once, this is the only consumer
+        Batch *batch = pendingBatches.exchange(nullptr, std::memory_order_acquire);
+
+        vector<vector<Match>> batches;
+        while ( batch != nullptr ) {
+            batches.push_back(std::move(batch->matches));
+            Batch *next = batch->next;
+            delete batch;
+            batch = next;
+        }
+
+        // The stack is LIFO, restore the order of arrival
+        std::reverse(batches.begin(), batches.end());
+        return batches;
+    }
+
+
     /** ***************************************************************************/
     void runSyncHandlers() {
 
@@ -98,10 +353,41 @@ public:
         connect(&futureWatcher, &QFutureWatcher<pair<QueryHandler*,uint>>::finished,
                 this, &QueryPrivate::onSyncHandlersFinsished);
 
-        // Run the handlers concurrently and measure the runtimes
-        futureWatcher.setFuture(QtConcurrent::mapped(syncHandlers.begin(),
-                                                     syncHandlers.end(),
-                                                     std::bind(&QueryPrivate::mappedFunction, this, std::placeholders::_1)));
+        // Run the handlers and measure the runtimes
+        futureWatcher.setFuture(runHandlers(syncHandlers));
+
+        // Do not let the slowest handler delay the first paint
+        if ( resultsShown )
+            return;
+        firstPaintTimer.setSingleShot(true);
+        connect(&firstPaintTimer, &QTimer::timeout,
+                this, &QueryPrivate::onFirstPaintDeadline);
+        firstPaintTimer.start(FIRST_PAINT_DEADLINE);
+    }
+
+
+    /** ***************************************************************************/
+    QFuture<pair<QueryHandler*,uint>> runHandlers(const set<QueryHandler*> &handlers) {
+
+        // Concurrently in the global pool
+        if ( threadPool == nullptr )
+            return QtConcurrent::mapped(handlers.begin(), handlers.end(),
+                                        std::bind(&QueryPrivate::mappedFunction, this, std::placeholders::_1));
+
+        // One after another in the given pool, yielding to real queries
+        QFutureInterface<pair<QueryHandler*,uint>> interface;
+        interface.reportStarted();
+        QFuture<pair<QueryHandler*,uint>> future = interface.future();
+        QtConcurrent::run(threadPool, [this, handlers, interface]() mutable {
+            QThread::currentThread()->setPriority(QThread::IdlePriority);
+            for ( QueryHandler *handler : handlers ) {
+                if ( !isValid )
+                    break;
+                interface.reportResult(mappedFunction(handler));
+            }
+            interface.reportFinished();
+        });
+        return future;
     }
 
 
@@ -113,10 +399,8 @@ public:
         connect(&futureWatcher, &QFutureWatcher<pair<QueryHandler*,uint>>::finished,
                 this, &QueryPrivate::onAsyncHandlersFinsished);
 
-        // Run the handlers concurrently and measure the runtimes
-        futureWatcher.setFuture(QtConcurrent::mapped(asyncHandlers.begin(),
-                                                     asyncHandlers.end(),
-                                                     std::bind(&QueryPrivate::mappedFunction, this, std::placeholders::_1)));
+        // Run the handlers and measure the runtimes
+        futureWatcher.setFuture(runHandlers(asyncHandlers));
 
         // Insert pending results every 50 milliseconds
         connect(&fiftyMsTimer, &QTimer::timeout, this, &QueryPrivate::insertPendingResults);
@@ -126,36 +410,33 @@ public:
 
 
     /** ***************************************************************************/
-    void onSyncHandlersFinsished() {
-
-        // Save the runtimes of the current future
-        for ( auto it = futureWatcher.future().begin(); it != futureWatcher.future().end(); ++it )
-            runtimes.emplace(it->first->id, it->second);
+    void onFirstPaintDeadline() {
 
-        /*
-         * Publish the results
-         */
+        // Nothing to show yet, check again next frame
+        if ( pendingBatches.load(std::memory_order_relaxed) == nullptr ) {
+            firstPaintTimer.start();
+            return;
+        }
 
-        // Lock the pending results
-        QMutexLocker lock(&pendingResultsMutex);
+        insertSortedPendingResults();
+        showResults();
+    }
 
-        // Sort the results
-        std::sort(pendingResults.begin(),
-                  pendingResults.end(),
-                  MatchCompare());
 
-        // Preallocate space in "results" to avoid multiple allocations
-        results.reserve(results.size() + pendingResults.size());
+    /** ***************************************************************************/
+    void onSyncHandlersFinsished() {
 
-        // Move the items of the "pending results" into "results"
-        std::transform(pendingResults.begin(),
-                       pendingResults.end(),
-                       std::back_inserter(results),
-                       [](const pair<shared_ptr<Item>,short>& p){ return std::move(p.first); });
+        firstPaintTimer.stop();
+        firstPaintTimer.disconnect();
 
-        pendingResults.clear();
+        // Save the runtimes of the current future
+        for ( auto it = futureWatcher.future().begin(); it != futureWatcher.future().end(); ++it )
+            runtimes.emplace(it->first->id, it->second);
 
-        emit q->resultsReady(this);
+        // Publish the results. Late results are ranked in below the stable rows
+        insertSortedPendingResults();
+        if ( !resultsShown )
+            showResults();
 
         if ( asyncHandlers.empty() )
             finishQuery();
@@ -180,55 +461,312 @@ public:
     }
 
 
+    /** ***************************************************************************/
+    const vector<shared_ptr<Item>> &getFallbacks() {
+
+        // Most queries never need them, compute them on first use
+        if ( !fallbacksComputed ) {
+            for ( FallbackProvider *provider : fallbackProviders ) {
+                vector<shared_ptr<Item>> && tmpFallbacks = provider->fallbacks(searchTerm);
+                fallbacks.insert(fallbacks.end(),
+                                 std::make_move_iterator(tmpFallbacks.begin()),
+                                 std::make_move_iterator(tmpFallbacks.end()));
+            }
+            fallbacksComputed = true;
+        }
+        return fallbacks;
+    }
+
+
+    /** ***************************************************************************/
+    void showResults() {
+        resultsShown = true;
+        timeToFirstResult = std::chrono::duration_cast<std::chrono::microseconds>(system_clock::now()-startTime).count();
+        emit q->resultsReady(this);
+    }
+
+
+    /** ***************************************************************************/
+    vector<Match> mergePendingBatches() {
+
+        vector<vector<Match>> batches = takeBatches();
+
+        size_t count = 0;
+        for ( const auto &batch : batches )
+            count += batch.size();
+
+        vector<Match> matches;
+        matches.reserve(count);
+
+        // K-way merge the sorted batches
+        auto worse = [this, &batches](const pair<size_t,size_t> &lhs, const pair<size_t,size_t> &rhs){
+            return compare(batches[rhs.first][rhs.second], batches[lhs.first][lhs.second]);
+        };
+        vector<pair<size_t,size_t>> heads; // (batch, position)
+        for ( size_t i = 0; i < batches.size(); ++i )
+            if ( !batches[i].empty() )
+                heads.emplace_back(i, 0);
+        std::make_heap(heads.begin(), heads.end(), worse);
+        while ( !heads.empty() ) {
+            std::pop_heap(heads.begin(), heads.end(), worse);
+            pair<size_t,size_t> &head = heads.back();
+            matches.push_back(std::move(batches[head.first][head.second]));
+            if ( ++head.second < batches[head.first].size() )
+                std::push_heap(heads.begin(), heads.end(), worse);
+            else
+                heads.pop_back();
+        }
+
+        return matches;
+    }
+
+
+    /** ***************************************************************************/
+    void insertSortedPendingResults() {
+
+        vector<Match> matches = mergePendingBatches();
+
+        // Late results are ranked in below the rows already shown
+        if ( resultsShown )
+            insertRanked(matches);
+        else {
+            results = std::move(matches);
+            visibleRows = std::min(PAGE_SIZE, results.size());
+        }
+    }
+
+
     /** ***************************************************************************/
     void insertPendingResults() {
+        vector<Match> matches = mergePendingBatches();
+        insertRanked(matches);
+    }
 
-        if(pendingResults.size()) {
 
-            QMutexLocker lock(&pendingResultsMutex);
+    /** ***************************************************************************/
+    void insertRanked(vector<Match> &matches) {
+
+        // Matches confirming cached results update their rows
+        if ( !unconfirmed.empty() ) {
+            auto fresh = matches.begin();
+            for ( Match &match : matches )
+                if ( !(unconfirmed.erase(match.key.idHash) != 0 && updateCachedRow(match)) ) {
+                    if ( &*fresh != &match )
+                        *fresh = std::move(match);
+                    ++fresh;
+                }
+            matches.erase(fresh, matches.end());
+        }
 
-            beginInsertRows(QModelIndex(), results.size(), results.size() + pendingResults.size() - 1);
+        /*
+         * Insert the sorted matches at their rank position. The first rows
+         * (stability zone) are the ones the user is looking at, never displace
+         * them. Below the zone the results are sorted, so the positions can be
+         * found by binary search. Matches going to the same position are
+         * inserted in one batch.
+         */
 
-            // Preallocate space to avoid multiple allocatoins
-            results.reserve(results.size() + pendingResults.size());
+        size_t pos = std::min(static_cast<size_t>(stableRows), results.size());
+        auto it = matches.begin();
+        while ( it != matches.end() ) {
+
+            // Find the position of the best remaining match
+            pos = std::upper_bound(results.begin() + pos, results.end(), *it, compare) - results.begin();
+
+            // Collect the matches that rank before the row at this position
+            auto last = ( pos == results.size() )
+                    ? matches.end()
+                    : std::find_if(it + 1, matches.end(),
+                                   [this, pos](const Match &match){
+                                       return !compare(match, results[pos]);
+                                   });
+
+            // Rows below the exposed ones are stored silently
+            size_t count = static_cast<size_t>(last - it);
+            bool visible = pos < visibleRows;
+            if ( visible )
+                beginInsertRows(QModelIndex(), pos, pos + count - 1);
+            results.insert(results.begin() + pos,
+                           std::make_move_iterator(it),
+                           std::make_move_iterator(last));
+            if ( visible ) {
+                visibleRows += count;
+                endInsertRows();
+            }
 
-            // Copy the items of the matches into the results
-            std::transform(pendingResults.begin(), pendingResults.end(),
-                           std::back_inserter(results),
-                           [](const pair<shared_ptr<Item>,short>& p){ return std::move(p.first); });
+            pos += count;
+            it = last;
+        }
+
+        // Fill up the first page
+        if ( visibleRows < PAGE_SIZE )
+            exposeRows(std::min(PAGE_SIZE, results.size()) - visibleRows);
+    }
 
-            endInsertRows();
 
-            // Clear the empty matches
-            pendingResults.clear();
+    /** ***************************************************************************/
+    bool updateCachedRow(Match &match) {
+
+        auto row = std::find_if(results.begin(), results.end(),
+                                [&match](const Match &result){ return result.key.idHash == match.key.idHash; });
+        if ( row == results.end() )
+            return false;
+        size_t pos = static_cast<size_t>(row - results.begin());
+
+        // The fresh item replaces the cached one, its state may have changed.
+        // It stays in place if the rank is still in order, the stable rows
+        // are never moved anyway.
+        if ( pos < stableRows
+             || ((pos == 0 || !compare(match, results[pos-1]))
+                 && (pos + 1 == results.size() || !compare(results[pos+1], match))) ) {
+            row->item = std::move(match.item);
+            row->key = match.key;
+            row->display.reset();
+            if ( pos < visibleRows )
+                emit dataChanged(index(static_cast<int>(pos)), index(static_cast<int>(pos)));
+            return true;
         }
+
+        // Otherwise it is ranked in again like a new match
+        if ( pos < visibleRows ) {
+            beginRemoveRows(QModelIndex(), static_cast<int>(pos), static_cast<int>(pos));
+            results.erase(row);
+            --visibleRows;
+            endRemoveRows();
+        } else
+            results.erase(row);
+        return false;
+    }
+
+
+    /** ***************************************************************************/
+    void exposeRows(size_t count) {
+        if ( count == 0 )
+            return;
+        beginInsertRows(QModelIndex(), visibleRows, visibleRows + count - 1);
+        visibleRows += count;
+        endInsertRows();
     }
 
 
     /** ***************************************************************************/
     void finishQuery() {
 
+        // Cached results the handlers did not return anymore are outdated
+        if ( !unconfirmed.empty() ) {
+            for ( size_t row = results.size(); row-- > 0; ) {
+                if ( unconfirmed.count(results[row].key.idHash) ) {
+                    if ( row < visibleRows ) {
+                        beginRemoveRows(QModelIndex(), row, row);
+                        results.erase(results.begin() + row);
+                        --visibleRows;
+                        endRemoveRows();
+                    } else
+                        results.erase(results.begin() + row);
+                }
+            }
+            unconfirmed.clear();
+        }
+
+        // The page the view asked for
+        if ( fetchPending ) {
+            fetchPending = false;
+            exposeRows(std::min(PAGE_SIZE, results.size() - visibleRows));
+        }
+
         /*
-         * If results are empty show fallbacks
+         * If results are empty show fallbacks. Nobody sees them for
+         * invalidated queries, so do not ask the providers.
          */
 
-        if( results.empty() ){
+        if( isValid && results.empty() && !getFallbacks().empty() ){
             beginInsertRows(QModelIndex(), 0, fallbacks.size() - 1);
-            results.insert(results.end(),
-                           fallbacks.begin(),
-                           fallbacks.end());
+            for ( const shared_ptr<Item> &fallback : fallbacks )
+                results.push_back(Match{fallback, compare.key(*fallback, 0)});
+            visibleRows = results.size();
             endInsertRows();
+            fallbacksShown = true;
         }
 
+        // All keys are computed, activations need not copy the scores anymore
+        compare.releaseScores();
+
         state = State::Finished;
 
         emit q->finished();
     }
 
 
+    /** ***************************************************************************/
+    const Display &display(const Match &match) const {
+
+        // Paints repeat a lot, call the virtuals only once per row
+        if ( !match.display ) {
+            Item &item = *match.item;
+            match.display.reset(new Display);
+            match.display->text = item.text();
+            match.display->subtext = item.subtext();
+            match.display->iconPath = item.iconPath();
+            for ( size_t i = 0; i < std::min(SNAPSHOT_ACTIONS, item.actionCount()); ++i )
+                match.display->actionTexts[i] = item.actionText(i);
+        }
+        return *match.display;
+    }
+
+
     /** ***************************************************************************/
     int rowCount(const QModelIndex &) const override {
-        return static_cast<int>(results.size());
+        return static_cast<int>(visibleRows);
+    }
+
+
+
+    /** ***************************************************************************/
+    bool canFetchMore(const QModelIndex &parent) const override {
+        return !parent.isValid() && (visibleRows < results.size() || canFetchDropped());
+    }
+
+
+
+    /** ***************************************************************************/
+    void fetchMore(const QModelIndex &parent) override {
+        // The user scrolled to the end of the exposed rows
+        if ( parent.isValid() )
+            return;
+        if ( visibleRows < results.size() )
+            exposeRows(std::min(PAGE_SIZE, results.size() - visibleRows));
+        else if ( canFetchDropped() )
+            fetchDropped();
+    }
+
+
+
+    /** ***************************************************************************/
+    bool canFetchDropped() const {
+        return matchesDropped && isValid && state == State::Finished && !fallbacksShown;
+    }
+
+
+
+    /** ***************************************************************************/
+    void fetchDropped() {
+
+        // The handlers dropped matches beyond the wanted count. Ask them for
+        // twice as many. The rows stored already are confirmed or updated
+        // like cached results, the new ones are ranked in below.
+        matchesDropped = false;
+        fetchPending = true;
+        wantedCount *= 2;
+        compare = MatchCompare(searchTerm);
+        unconfirmed.clear();
+        for ( const Match &match : results )
+            unconfirmed.insert(match.key.idHash);
+
+        state = State::Running;
+        if ( !syncHandlers.empty() )
+            runSyncHandlers();
+        else
+            runAsyncHandlers();
     }
 
 
@@ -236,33 +774,36 @@ public:
     /** ***************************************************************************/
     QVariant data(const QModelIndex &index, int role) const override {
         if (index.isValid()) {
-            const shared_ptr<Item> &item = results[static_cast<size_t>(index.row())];
+            const Match &match = results[static_cast<size_t>(index.row())];
+            const shared_ptr<Item> &item = match.item;
 
             switch (role) {
             case Qt::DisplayRole:
-                return item->text();
+                return display(match).text;
             case Qt::ToolTipRole:
-                return item->subtext();
+                return display(match).subtext;
             case Qt::DecorationRole:
-                return item->iconPath();
+                return display(match).iconPath;
 
             case Qt::UserRole: { // Actions list
                 QStringList actionTexts;
-                for (const shared_ptr<Action> &action : item->actions())
-                    actionTexts.append(action->text());
+                for (size_t i = 0; i < item->actionCount(); ++i)
+                    actionTexts.append(item->actionText(i));
                 return actionTexts;
             }
 
             case Qt::UserRole+100: // DefaultAction
-                return (0 < static_cast<int>(item->actions().size())) ? item->actions()[0]->text() : item->subtext();
-            case Qt::UserRole+101: // AltAction
-                return "Search '"+searchTerm+"' using default fallback";
             case Qt::UserRole+102: // MetaAction
-                return (1 < static_cast<int>(item->actions().size())) ? item->actions()[1]->text() : item->subtext();
             case Qt::UserRole+103: // ControlAction
-                return (2 < static_cast<int>(item->actions().size())) ? item->actions()[2]->text() : item->subtext();
-            case Qt::UserRole+104: // ShiftAction
-                return (3 < static_cast<int>(item->actions().size())) ? item->actions()[3]->text() : item->subtext();
+            case Qt::UserRole+104: { // ShiftAction
+                const Display &snapshot = display(match);
+                const QString &actionText = snapshot.actionTexts[(role == Qt::UserRole+100) ? 0 : role-Qt::UserRole-101];
+                return actionText.isNull() ? snapshot.subtext : actionText;
+            }
+            case Qt::UserRole+101: // AltAction
+                return altActionText;
+            case Qt::UserRole+105: // ItemId
+                return static_cast<qulonglong>(match.key.idHash);
             default:
                 return QVariant();
             }
@@ -272,55 +813,66 @@ public:
 
 
 
+    /** ***************************************************************************/
+    static void activateLater(const shared_ptr<Item> &item, size_t action) {
+
+        // The frontend hides right after the activation request. Run the action
+        // in the next event loop iteration, so it never delays the hiding.
+        system_clock::time_point requested = system_clock::now();
+        QTimer *timer = new QTimer(qApp);
+        timer->setSingleShot(true);
+        connect(timer, &QTimer::timeout, [timer, item, action, requested](){
+            system_clock::time_point start = system_clock::now();
+            item->activateAction(action);
+            system_clock::time_point end = system_clock::now();
+            lastActivationDelay = std::chrono::duration_cast<std::chrono::microseconds>(start-requested).count();
+            lastActivationTime = std::chrono::duration_cast<std::chrono::microseconds>(end-start).count();
+            timer->deleteLater();
+        });
+        timer->start(0);
+    }
+
+
     /** ***************************************************************************/
     bool setData(const QModelIndex &index, const QVariant &value, int role) override {
         if (index.isValid()) {
-            shared_ptr<Item> &item = results[static_cast<size_t>(index.row())];
+            shared_ptr<Item> &item = results[static_cast<size_t>(index.row())].item;
             QString itemId = item->id();
 
             switch (role) {
 
             // Activation by index
-            case Qt::UserRole:{
-                size_t actionValue = static_cast<size_t>(value.toInt());
-                if (actionValue < item->actions().size())
-                    item->actions()[actionValue]->activate();
+            case Qt::UserRole:
+                activateLater(item, static_cast<size_t>(value.toInt()));
                 break;
-            }
 
             // Activation by modifier
             case Qt::UserRole+100: // DefaultAction
-                if (0U < item->actions().size())
-                    item->actions()[0]->activate();
+                activateLater(item, 0);
                 break;
             case Qt::UserRole+101: // AltAction
-                if (0U < fallbacks.size() && 0U < item->actions().size()) {
-                    fallbacks[0]->actions()[0]->activate();
+                if (0U < getFallbacks().size() && 0U < item->actionCount()) {
+                    activateLater(fallbacks[0], 0);
                     itemId = fallbacks[0]->id();
                 }
                 break;
             case Qt::UserRole+102: // MetaAction
-                if (1U < item->actions().size())
-                    item->actions()[1]->activate();
+                activateLater(item, 1);
                 break;
             case Qt::UserRole+103: // ControlAction
-                if (2U < item->actions().size())
-                    item->actions()[2]->activate();
+                activateLater(item, 2);
                 break;
             case Qt::UserRole+104: // ShiftAction
-                if (3U < item->actions().size())
-                    item->actions()[3]->activate();
+                activateLater(item, 3);
                 break;
 
             }
 
+            // Update the usage scores
+            FrecencyModel::instance()->addUsage(searchTerm, itemId);
+
             // Save usage
-            QSqlQuery query;
-            query.prepare("INSERT INTO usages (input, itemId) VALUES (:input, :itemId);");
-            query.bindValue(":input", searchTerm);
-            query.bindValue(":itemId", item->id());
-            if (!query.exec())
-                qWarning() << query.lastError();
+            PersistenceThread::instance()->addUsage(searchTerm, itemId);
         }
         return false;
     }
@@ -333,7 +885,7 @@ public:
 /** ***************************************************************************/
 /** ***************************************************************************/
 /** ***************************************************************************/
-Core::Query::Query() : d(new QueryPrivate(this)) {
+Core::Query::Query() : d(QueryPrivate::acquire(this)) {
 
 }
 
@@ -341,6 +893,19 @@ Core::Query::Query() : d(new QueryPrivate(this)) {
 /** ***************************************************************************/
 Core::Query::~Query() {
 
+    // The query manager deletes queries only after their handlers finished
+    Q_ASSERT(d->state != State::Running);
+
+    // Recycle the model
+    QueryPrivate::release(std::move(d));
+}
+
+
+/** ***************************************************************************/
+void Core::Query::clearModelPool() {
+    // The models own timers, free them while the application still exists
+    QueryPrivate::pool().clear();
+    QueryPrivate::poolClosed() = true;
 }
 
 
@@ -365,9 +930,25 @@ bool Core::Query::isValid() const {
 /** ***************************************************************************/
 void Core::Query::addMatch(shared_ptr<Item> item, short score) {
     if ( d->isValid ) {
-        d->pendingResultsMutex.lock();
-        d->pendingResults.push_back({item, score});
-        d->pendingResultsMutex.unlock();
+
+        // Compute the ranking keys once, in the producing thread
+        MatchCompare::Key key = d->compare.key(*item, score);
+
+        // Matches of foreign threads are handed over immediately
+        if ( stagingBuffer.query != d.get() ) {
+            vector<Match> matches;
+            matches.push_back(Match{std::move(item), key});
+            d->pushBatch(std::move(matches));
+            return;
+        }
+
+        if ( !d->admit(key) )
+            return;
+
+        stagingBuffer.matches.push_back(Match{std::move(item), key});
+        if ( stagingBuffer.streaming
+             && system_clock::now() - stagingBuffer.lastFlush > std::chrono::milliseconds(STAGING_INTERVAL) )
+            d->flushStagingBuffer();
     }
 }
 
@@ -375,25 +956,93 @@ void Core::Query::addMatch(shared_ptr<Item> item, short score) {
 /** ***************************************************************************/
 void Core::Query::addMatches(vector<pair<shared_ptr<Item>,short>>::iterator begin,
                              vector<pair<shared_ptr<Item>,short>>::iterator end) {
-    if ( d->isValid ) {
-        d->pendingResultsMutex.lock();
-        d->pendingResults.insert(d->pendingResults.end(),
-                                 std::make_move_iterator(begin),
-                                 std::make_move_iterator(end));
-        d->pendingResultsMutex.unlock();
+    if ( d->isValid && begin != end ) {
+
+        // Compute the ranking keys once, in the producing thread
+        bool staged = stagingBuffer.query == d.get();
+        vector<Match> matches;
+        matches.reserve(std::min(static_cast<size_t>(end - begin), staged ? size_t(d->wantedCount) : SIZE_MAX));
+        for ( auto it = begin; it != end; ++it ) {
+            MatchCompare::Key key = d->compare.key(*it->first, it->second);
+            if ( !staged || d->admit(key) )
+                matches.push_back(Match{std::move(it->first), key});
+        }
+
+        // Matches of foreign threads are handed over immediately
+        if ( !staged ) {
+            d->pushBatch(std::move(matches));
+            return;
+        }
+
+        stagingBuffer.matches.insert(stagingBuffer.matches.end(),
+                                     std::make_move_iterator(matches.begin()),
+                                     std::make_move_iterator(matches.end()));
+        if ( stagingBuffer.streaming )
+            d->flushStagingBuffer();
     }
 }
 
 
+/** ***************************************************************************/
+uint Core::Query::wantedCount() const {
+    return d->wantedCount;
+}
+
+
+/** ***************************************************************************/
+bool Core::Query::isWanted(const QString &id, short score) const {
+    if ( !d->isValid )
+        return false;
+    if ( stagingBuffer.query != d.get() )
+        return true;
+    if ( d->isCompetitive(d->compare.key(id, score)) )
+        return true;
+    d->matchesDropped = true;
+    return false;
+}
+
+
 /** ***************************************************************************/
 std::map<QString,uint> Core::Query::runtimes() {
     return d->runtimes;
 }
 
 
+/** ***************************************************************************/
+uint Core::Query::timeToFirstResult() const {
+    return d->timeToFirstResult;
+}
+
+
+/** ***************************************************************************/
+uint Core::Query::activationDelay() {
+    return lastActivationDelay;
+}
+
+
+/** ***************************************************************************/
+uint Core::Query::activationTime() {
+    return lastActivationTime;
+}
+
+
+/** ***************************************************************************/
+uint Core::Query::batchCount() const {
+    return d->batchCount.load();
+}
+
+
+/** ***************************************************************************/
+uint Core::Query::contendedPushes() const {
+    return d->contendedPushes.load();
+}
+
+
 /** ***************************************************************************/
 void Core::Query::setSearchTerm(const QString &searchTerm) {
     d->searchTerm = searchTerm;
+    d->altActionText = "Search '"+searchTerm+"' using default fallback";
+    d->compare = MatchCompare(searchTerm);
 }
 
 
@@ -417,12 +1066,57 @@ void Core::Query::setQueryHandlers(const set<QueryHandler *> &queryHandlers) {
 
 
 /** ***************************************************************************/
-void Core::Query::setFallbacks(const vector<shared_ptr<Core::Item> > &fallbacks) {
+void Core::Query::setWantedCount(uint count) {
+    d->wantedCount = std::max(count, 1u);
+}
+
+
+/** ***************************************************************************/
+void Core::Query::setStableRows(uint rows) {
+    d->stableRows = rows;
+}
+
+
+/** ***************************************************************************/
+void Core::Query::setThreadPool(QThreadPool *pool) {
+    d->threadPool = pool;
+}
+
+
+/** ***************************************************************************/
+void Core::Query::setCachedResults(const vector<pair<shared_ptr<Item>,short>> &cachedResults) {
+
+    if (d->state != State::Idle)
+        return;
+
+    d->results.clear();
+    d->unconfirmed.clear();
+    for ( const pair<shared_ptr<Item>,short> &result : cachedResults ) {
+        d->results.push_back(Match{result.first, d->compare.key(*result.first, result.second)});
+        d->unconfirmed.insert(d->results.back().key.idHash);
+    }
+    std::sort(d->results.begin(), d->results.end(), d->compare);
+    d->visibleRows = std::min(PAGE_SIZE, d->results.size());
+}
+
+
+/** ***************************************************************************/
+vector<pair<shared_ptr<Core::Item>,short>> Core::Query::topResults(size_t count) const {
+    vector<pair<shared_ptr<Item>,short>> topResults;
+    if ( !d->fallbacksShown )
+        for ( size_t i = 0; i < std::min(count, d->results.size()); ++i )
+            topResults.emplace_back(d->results[i].item, d->results[i].key.matchScore);
+    return topResults;
+}
+
+
+/** ***************************************************************************/
+void Core::Query::setFallbackProviders(const set<FallbackProvider*> &providers) {
 
     if (d->state != State::Idle)
         return;
 
-     d->fallbacks = fallbacks;
+    d->fallbackProviders = providers;
 }
 
 
@@ -56,3 +56,16 @@ vector<shared_ptr<Core::Action>> Core::StandardItem::actions(){
 void Core::StandardItem::setActions(vector<shared_ptr<Action> > &&actions){
     actions_ = actions;
 }
+
+size_t Core::StandardItem::actionCount(){
+    return actions_.size();
+}
+
+QString Core::StandardItem::actionText(size_t i){
+    return (i < actions_.size()) ? actions_[i]->text() : QString();
+}
+
+void Core::StandardItem::activateAction(size_t i){
+    if (i < actions_.size())
+        actions_[i]->activate();
+}
@@ -22,7 +22,6 @@
 #include <QFile>
 #include <QFileSystemWatcher>
 #include <QPointer>
-#include <QProcess>
 #include <QRegularExpression>
 #include <QSettings>
 #include <QStandardPaths>
@@ -38,8 +37,10 @@
 #include "offlineindex.h"
 #include "query.h"
 #include "queryhandler.h"
+#include "indexable.h"
+#include "item.h"
+#include "launcher.h"
 #include "standardaction.h"
-#include "standardindexitem.h"
 #include "xdgiconlookup.h"
 using std::map;
 using std::pair;
@@ -259,10 +260,96 @@ QStringList shellLexerSplit(const QString &input) {
 
 
 /** ***************************************************************************/
-vector<shared_ptr<StandardIndexItem>> indexApplications() {
+/**
+ * A desktop entry. Holds the command lines of its actions and runs them
+ * directly on activation, action objects are only built if asked for.
+ */
+class DesktopEntry final : public Item, public Indexable
+{
+public:
+
+    struct DesktopAction {
+        QString text;
+        QStringList commandline;
+        bool asRoot;
+    };
+
+    DesktopEntry(const QString &id, bool term, const QString &workingDir)
+        : id_(id), term_(term), workingDir_(workingDir) {}
+
+    QString id() const override { return id_; }
+    QString text() const override { return text_; }
+    QString subtext() const override { return subtext_; }
+    QString iconPath() const override { return iconPath_; }
+    vector<Indexable::WeightedKeyword> indexKeywords() const override { return indexKeywords_; }
+
+    void setText(const QString &text) { text_ = text; }
+    void setSubtext(const QString &subtext) { subtext_ = subtext; }
+    void setIconPath(const QString &iconPath) { iconPath_ = iconPath; }
+    void setIndexKeywords(vector<Indexable::WeightedKeyword> &&keywords) { indexKeywords_ = std::move(keywords); }
+    void setDesktopActions(vector<DesktopAction> &&actions) { desktopActions_ = std::move(actions); }
+
+    vector<shared_ptr<Action>> actions() override {
+        vector<shared_ptr<Action>> actions;
+        for (const DesktopAction &desktopAction : desktopActions_) {
+            // Actions may outlive the entry, e.g. after a reindex
+            bool term = term_;
+            QString workingDir = workingDir_;
+            actions.push_back(std::make_shared<StandardAction>(desktopAction.text,
+                                                               [desktopAction, term, workingDir](){
+                                                                   run(desktopAction, term, workingDir);
+                                                               }));
+        }
+        return actions;
+    }
+
+    size_t actionCount() override {
+        return desktopActions_.size();
+    }
+
+    QString actionText(size_t i) override {
+        return (i < desktopActions_.size()) ? desktopActions_[i].text : QString();
+    }
+
+    void activateAction(size_t i) override {
+        if (i < desktopActions_.size())
+            run(desktopActions_[i], term_, workingDir_);
+    }
+
+private:
+
+    static void run(const DesktopAction &action, bool term, const QString &workingDir) {
+        QStringList arguments;
+        if (term) {
+            arguments = shellLexerSplit(terminalCommand);
+            if (action.asRoot)
+                arguments.append(QString("sudo %1").arg(action.commandline.join(' ')));
+            else
+                arguments.append(action.commandline);
+        } else
+            arguments = action.commandline;
+        QString command = arguments.takeFirst();
+        Core::Launcher::startDetached(command, arguments, workingDir);
+    }
+
+    QString id_;
+    QString text_;
+    QString subtext_;
+    QString iconPath_;
+    bool term_;
+    QString workingDir_;
+    vector<Indexable::WeightedKeyword> indexKeywords_;
+    vector<DesktopAction> desktopActions_;
+
+};
+
+
+
+/** ***************************************************************************/
+vector<shared_ptr<DesktopEntry>> indexApplications() {
 
     // Get a new index [O(n)]
-    vector<shared_ptr<StandardIndexItem>> desktopEntries;
+    vector<shared_ptr<DesktopEntry>> desktopEntries;
     QStringList xdg_current_desktop = QString(getenv("XDG_CURRENT_DESKTOP")).split(':',QString::SkipEmptyParts);
     QLocale loc;
     QStringList xdgAppDirs = QStandardPaths::standardLocations(QStandardPaths::ApplicationsLocation);
@@ -290,7 +377,7 @@ vector<shared_ptr<StandardIndexItem>> indexApplications() {
 
             // Skip duplicate ids
             if ( std::find_if(desktopEntries.begin(), desktopEntries.end(),
-                              [&id](const shared_ptr<StandardIndexItem> & desktopEntry){
+                              [&id](const shared_ptr<DesktopEntry> & desktopEntry){
                                   return id == desktopEntry->id();
                               }) != desktopEntries.end())
                 continue;
@@ -410,7 +497,7 @@ vector<shared_ptr<StandardIndexItem>> indexApplications() {
              * Default action
              */
 
-            vector<shared_ptr<Action>> actions;
+            vector<DesktopEntry::DesktopAction> actions;
 
             // Unquote arguments and expand field codes
             QStringList commandline = expandedFieldCodes(shellLexerSplit(exec),
@@ -418,60 +505,15 @@ vector<shared_ptr<StandardIndexItem>> indexApplications() {
                                                          name,
                                                          fIt.filePath());
 
-            shared_ptr<StandardAction> sa = std::make_shared<StandardAction>();
-            sa->setText(QString("Run %1").arg(name));
-            if (term){
-                sa->setAction([commandline, workingDir](){
-                    QStringList arguments = shellLexerSplit(terminalCommand);
-                    arguments.append(commandline);
-                    QString command = arguments.takeFirst();
-                    QProcess::startDetached(command, arguments, workingDir);
-                });
-            } else {
-                sa->setAction([commandline, workingDir](){
-                    QStringList arguments = commandline;
-                    QString command = arguments.takeFirst();
-                    QProcess::startDetached(command, arguments, workingDir);
-                });
-            }
-
-            actions.push_back(sa);
+            actions.push_back({QString("Run %1").arg(name), commandline, false});
 
 
             /*
              * Root action
              */
 
-            if (term){
-                sa = std::make_shared<StandardAction>();
-                sa->setText(QString("Run %1 as root").arg(name));
-                sa->setAction([commandline, workingDir](){
-                    QStringList arguments = shellLexerSplit(terminalCommand);
-                    arguments.append(QString("sudo %1").arg(commandline.join(' ')));
-                    QString command = arguments.takeFirst();
-                    QProcess::startDetached(command, arguments, workingDir);
-                });
-                actions.push_back(sa);
-            }
-//            else {
-//             Root action. (FistComeFirstsServed. TODO: more sophisticated solution)
-//            for (const QString &s : supportedGraphicalSudo){
-//                QProcess p;
-//                p.start("which", {s});
-//                p.waitForFinished(-1);
-//                if (p.exitCode() == 0){
-//                    actions_.push_back(std::make_shared<DesktopAction>(
-//                                           this, QString("Run %1 as root").arg(name_),
-//                                           QString("%1 \"%2\"").arg(s, exec_)));
-//                    break;
-//                }
-//            }
-//                sa->setAction([commandline, workingDir](){
-//                    QStringList arguments = commandline;
-//                    QString command = arguments.takeFirst();
-//                    QProcess::startDetached(command, arguments, workingDir);
-//                });
-//            }
+            if (term)
+                actions.push_back({QString("Run %1 as root").arg(name), commandline, true});
 
 
             /*
@@ -480,8 +522,6 @@ vector<shared_ptr<StandardIndexItem>> indexApplications() {
 
             for (const QString &actionIdentifier: actionIdentifiers){
 
-                sa = std::make_shared<StandardAction>();
-
                 // Get iterator to action section
                 if ((sectionIterator = sectionMap.find(QString("Desktop Action %1").arg(actionIdentifier))) == sectionMap.end())
                     continue;
@@ -491,7 +531,6 @@ vector<shared_ptr<StandardIndexItem>> indexApplications() {
                 QString actionName = xdgStringEscape(getLocalizedKey("Name", valueMap, loc));
                 if (actionName.isNull())
                     continue;
-                sa->setText(actionName);
 
                 // Get action command
                 if ((entryIterator = valueMap.find("Exec")) == valueMap.end())
@@ -503,21 +542,7 @@ vector<shared_ptr<StandardIndexItem>> indexApplications() {
                                                              name,
                                                              fIt.filePath());
 
-                if (term){
-                    sa->setAction([commandline, workingDir](){
-                        QStringList arguments = shellLexerSplit(terminalCommand);
-                        arguments.append(commandline);
-                        QString command = arguments.takeFirst();
-                        QProcess::startDetached(command, arguments, workingDir);
-                    });
-                } else {
-                    sa->setAction([commandline, workingDir](){
-                        QStringList arguments = commandline;
-                        QString command = arguments.takeFirst();
-                        QProcess::startDetached(command, arguments, workingDir);
-                    });
-                }
-                actions.push_back(sa);
+                actions.push_back({actionName, commandline, false});
             }
 
 
@@ -526,7 +551,7 @@ vector<shared_ptr<StandardIndexItem>> indexApplications() {
              */
 
             // Finally we got everything, build the item
-            shared_ptr<StandardIndexItem> ssii = std::make_shared<StandardIndexItem>(id);
+            shared_ptr<DesktopEntry> ssii = std::make_shared<DesktopEntry>(id, term, workingDir);
 
             // Set Name
             ssii->setText(name);
@@ -560,7 +585,7 @@ vector<shared_ptr<StandardIndexItem>> indexApplications() {
             ssii->setIndexKeywords(std::move(indexKeywords));
 
             // Set actions
-            ssii->setActions(std::move(actions));
+            ssii->setDesktopActions(std::move(actions));
 
             desktopEntries.push_back(std::move(ssii));
         }
@@ -579,20 +604,21 @@ vector<shared_ptr<StandardIndexItem>> indexApplications() {
 class Applications::ApplicationsPrivate
 {
 public:
-    ApplicationsPrivate(Extension *q) : q(q) {}
+    ApplicationsPrivate(Extension *q) : q(q), generation(0) {}
 
     Extension *q;
+    uint generation;
 
     QPointer<ConfigWidget> widget;
     QFileSystemWatcher watcher;
 
-    vector<shared_ptr<Core::StandardIndexItem>> index;
+    vector<shared_ptr<DesktopEntry>> index;
     OfflineIndex offlineIndex;
 
     QTimer updateDelayTimer;
     void finishIndexing();
     void startIndexing();
-    QFutureWatcher<vector<shared_ptr<Core::StandardIndexItem>>> futureWatcher;
+    QFutureWatcher<vector<shared_ptr<DesktopEntry>>> futureWatcher;
 };
 
 
@@ -606,7 +632,7 @@ void Applications::ApplicationsPrivate::startIndexing() {
 
     // Run finishIndexing when the indexing thread finished
     futureWatcher.disconnect();
-    QObject::connect(&futureWatcher, &QFutureWatcher<vector<shared_ptr<Core::StandardIndexItem>>>::finished,
+    QObject::connect(&futureWatcher, &QFutureWatcher<vector<shared_ptr<DesktopEntry>>>::finished,
                      std::bind(&ApplicationsPrivate::finishIndexing, this));
 
     // Run the indexer thread
@@ -630,6 +656,7 @@ void Applications::ApplicationsPrivate::finishIndexing() {
     offlineIndex.clear();
     for (const auto &item : index)
         offlineIndex.add(item);
+    ++generation;
 
     // Finally update the watches (maybe folders changed)
     if (!watcher.directories().isEmpty())
@@ -720,13 +747,20 @@ void Applications::Extension::handleQuery(Core::Query * query) {
     vector<pair<shared_ptr<Core::Item>,short>> results;
     for (const shared_ptr<Core::Indexable> &item : indexables)
         // TODO `Search` has to determine the relevance. Set to 0 for now
-        results.emplace_back(std::static_pointer_cast<Core::StandardIndexItem>(item), 1);
+        results.emplace_back(std::static_pointer_cast<DesktopEntry>(item), 1);
 
     query->addMatches(results.begin(), results.end());
 }
 
 
 
+/** ***************************************************************************/
+uint Applications::Extension::indexGeneration() const {
+    return d->generation;
+}
+
+
+
 /** ***************************************************************************/
 bool Applications::Extension::fuzzy() {
     return d->offlineIndex.fuzzy();
@@ -738,6 +772,7 @@ bool Applications::Extension::fuzzy() {
 void Applications::Extension::setFuzzy(bool b) {
     QSettings(qApp->applicationName()).setValue(QString("%1/%2").arg(Core::Extension::id, CFG_FUZZY), b);
     d->offlineIndex.setFuzzy(b);
+    ++d->generation;
 }
 
 
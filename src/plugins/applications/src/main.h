@@ -45,6 +45,7 @@ public:
     QString name() const override { return "Applications"; }
     QWidget *widget(QWidget *parent = nullptr) override;
     void handleQuery(Core::Query * query) override;
+    uint indexGeneration() const override;
 
     /*
      * Extension specific members
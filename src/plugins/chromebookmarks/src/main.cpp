@@ -18,7 +18,6 @@
 #include <QApplication>
 #include <QClipboard>
 #include <QDebug>
-#include <QDesktopServices>
 #include <QDir>
 #include <QDirIterator>
 #include <QFile>
@@ -44,8 +43,9 @@
 #include "offlineindex.h"
 #include "query.h"
 #include "queryhandler.h"
+#include "item.h"
+#include "launcher.h"
 #include "standardaction.h"
-#include "standardindexitem.h"
 #include "xdgiconlookup.h"
 using std::shared_ptr;
 using std::vector;
@@ -59,10 +59,73 @@ const char* CFG_FUZZY = "fuzzy";
 const bool  DEF_FUZZY = false;
 
 /** ***************************************************************************/
-vector<shared_ptr<StandardIndexItem>> indexChromeBookmarks(const QString &bookmarksPath) {
+/**
+ * A bookmark. The actions are run directly on activation, action objects are
+ * only built if asked for.
+ */
+class Bookmark final : public Item, public Indexable
+{
+public:
+
+    Bookmark(const QString &id, const QString &name, const QString &url, const QString &iconPath)
+        : id_(id), name_(name), url_(url), iconPath_(iconPath) {}
+
+    QString id() const override { return id_; }
+    QString text() const override { return name_; }
+    QString subtext() const override { return url_; }
+    QString iconPath() const override { return iconPath_; }
+    vector<Indexable::WeightedKeyword> indexKeywords() const override { return indexKeywords_; }
+
+    void setIndexKeywords(vector<Indexable::WeightedKeyword> &&keywords) { indexKeywords_ = std::move(keywords); }
+
+    vector<shared_ptr<Action>> actions() override {
+        vector<shared_ptr<Action>> actions;
+        // Actions may outlive the bookmark, e.g. after a reindex
+        QString url = url_;
+        for (size_t i = 0; i < actionCount(); ++i)
+            actions.push_back(std::make_shared<StandardAction>(actionText(i), [url, i](){ activate(i, url); }));
+        return actions;
+    }
+
+    size_t actionCount() override {
+        return 2;
+    }
+
+    QString actionText(size_t i) override {
+        switch (i) {
+        case 0: return "Open in default browser";
+        case 1: return "Copy url to clipboard";
+        default: return QString();
+        }
+    }
+
+    void activateAction(size_t i) override {
+        activate(i, url_);
+    }
+
+private:
+
+    static void activate(size_t i, const QString &url) {
+        switch (i) {
+        case 0: Core::Launcher::openUrl(QUrl(url)); break;
+        case 1: QApplication::clipboard()->setText(url); break;
+        }
+    }
+
+    QString id_;
+    QString name_;
+    QString url_;
+    QString iconPath_;
+    vector<Indexable::WeightedKeyword> indexKeywords_;
+
+};
+
+
+/** ***************************************************************************/
+vector<shared_ptr<Bookmark>> indexChromeBookmarks(const QString &bookmarksPath) {
 
     // Build a new index
-    vector<shared_ptr<StandardIndexItem>> bookmarks;
+    vector<shared_ptr<Bookmark>> bookmarks;
 
     // Define a recursive bookmark indexing lambda
     std::function<void(const QJsonObject &json)> rec_bmsearch =
@@ -79,9 +142,6 @@ vector<shared_ptr<StandardIndexItem>> indexChromeBookmarks(const QString &bookma
             QString name = json["name"].toString();
             QString urlstr = json["url"].toString();
 
-            shared_ptr<StandardIndexItem> ssii  = std::make_shared<StandardIndexItem>(json["id"].toString());
-            ssii->setText(name);
-            ssii->setSubtext(urlstr);
             QString icon = XdgIconLookup::instance()->themeIconPath("www");
             if (icon.isEmpty())
                 icon = XdgIconLookup::instance()->themeIconPath("web-browser");
@@ -89,7 +149,7 @@ vector<shared_ptr<StandardIndexItem>> indexChromeBookmarks(const QString &bookma
                 icon = XdgIconLookup::instance()->themeIconPath("emblem-web");
             if (icon.isEmpty())
                 icon = ":favicon";
-            ssii->setIconPath(icon);
+            shared_ptr<Bookmark> ssii  = std::make_shared<Bookmark>(json["id"].toString(), name, urlstr, icon);
 
             vector<Indexable::WeightedKeyword> weightedKeywords;
             QUrl url(urlstr);
@@ -98,23 +158,6 @@ vector<shared_ptr<StandardIndexItem>> indexChromeBookmarks(const QString &bookma
             weightedKeywords.emplace_back(host.left(host.size()-url.topLevelDomain().size()), USHRT_MAX/2);
             ssii->setIndexKeywords(std::move(weightedKeywords));
 
-            vector<shared_ptr<Action>> actions;
-            shared_ptr<StandardAction> action = std::make_shared<StandardAction>();
-            action->setText("Open in default browser");
-            action->setAction([urlstr](){
-                QDesktopServices::openUrl(QUrl(urlstr));
-            });
-            actions.push_back(std::move(action));
-
-            action = std::make_shared<StandardAction>();
-            action->setText("Copy url to clipboard");
-            action->setAction([urlstr](){
-                QApplication::clipboard()->setText(urlstr);
-            });
-            actions.push_back(std::move(action));
-
-            ssii->setActions(std::move(actions));
-
             bookmarks.push_back(std::move(ssii));
         }
     };
@@ -122,7 +165,7 @@ vector<shared_ptr<StandardIndexItem>> indexChromeBookmarks(const QString &bookma
     QFile f(bookmarksPath);
     if (!f.open(QIODevice::ReadOnly)) {
         qWarning() << qPrintable(QString("Could not open %1").arg(bookmarksPath));
-        return vector<shared_ptr<StandardIndexItem>>();
+        return vector<shared_ptr<Bookmark>>();
     }
 
     QJsonObject json = QJsonDocument::fromJson(f.readAll()).object();
@@ -147,17 +190,18 @@ vector<shared_ptr<StandardIndexItem>> indexChromeBookmarks(const QString &bookma
 class ChromeBookmarks::ChromeBookmarksPrivate
 {
 public:
-    ChromeBookmarksPrivate(Extension *q) : q(q) {}
+    ChromeBookmarksPrivate(Extension *q) : q(q), generation(0) {}
 
     Extension *q;
+    uint generation;
 
     QPointer<ConfigWidget> widget;
     QFileSystemWatcher fileSystemWatcher;
     QString bookmarksFile;
 
-    vector<shared_ptr<Core::StandardIndexItem>> index;
+    vector<shared_ptr<Bookmark>> index;
     Core::OfflineIndex offlineIndex;
-    QFutureWatcher<vector<shared_ptr<Core::StandardIndexItem>>> futureWatcher;
+    QFutureWatcher<vector<shared_ptr<Bookmark>>> futureWatcher;
 
     void finishIndexing();
     void startIndexing();
@@ -174,7 +218,7 @@ void ChromeBookmarks::ChromeBookmarksPrivate::startIndexing() {
 
     // Run finishIndexing when the indexing thread finished
     futureWatcher.disconnect();
-    QObject::connect(&futureWatcher, &QFutureWatcher<vector<shared_ptr<Core::StandardIndexItem>>>::finished,
+    QObject::connect(&futureWatcher, &QFutureWatcher<vector<shared_ptr<Bookmark>>>::finished,
                      std::bind(&ChromeBookmarksPrivate::finishIndexing, this));
 
     // Run the indexer thread
@@ -198,6 +242,7 @@ void ChromeBookmarks::ChromeBookmarksPrivate::finishIndexing() {
     offlineIndex.clear();
     for (const auto &item : index)
         offlineIndex.add(item);
+    ++generation;
 
     /*
      * Finally update the watches (maybe folders changed)
@@ -300,13 +345,20 @@ void ChromeBookmarks::Extension::handleQuery(Core::Query * query) {
     // Add results to query
     vector<pair<shared_ptr<Core::Item>,short>> results;
     for (const shared_ptr<Core::Indexable> &item : indexables)
-        results.emplace_back(std::static_pointer_cast<Core::StandardIndexItem>(item), 0);
+        results.emplace_back(std::static_pointer_cast<Bookmark>(item), 0);
 
     query->addMatches(results.begin(), results.end());
 }
 
 
 
+/** ***************************************************************************/
+uint ChromeBookmarks::Extension::indexGeneration() const {
+    return d->generation;
+}
+
+
+
 /** ***************************************************************************/
 const QString &ChromeBookmarks::Extension::path() {
     return d->bookmarksFile;
@@ -361,5 +413,6 @@ void ChromeBookmarks::Extension::updateIndex() {
 void ChromeBookmarks::Extension::setFuzzy(bool b) {
     QSettings(qApp->applicationName()).setValue(QString("%1/%2").arg(Core::Extension::id, CFG_FUZZY), b);
     d->offlineIndex.setFuzzy(b);
+    ++d->generation;
 }
 
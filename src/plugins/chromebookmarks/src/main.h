@@ -46,6 +46,7 @@ public:
     QString name() const override { return "Chrome bookmarks"; }
     QWidget *widget(QWidget *parent = nullptr) override;
     void handleQuery(Core::Query * query) override;
+    uint indexGeneration() const override;
 
     /*
      * Extension specific members
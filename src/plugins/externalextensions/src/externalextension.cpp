@@ -25,6 +25,7 @@
 #include <QVBoxLayout>
 #include <vector>
 #include "externalextension.h"
+#include "launcher.h"
 #include "standardaction.h"
 #include "standarditem.h"
 #include "query.h"
@@ -368,7 +369,7 @@ void ExternalExtensions::ExternalExtension::handleQuery(Query* query) {
             QStringList arguments;
             for (const QJsonValue & value : object["arguments"].toArray())
                  arguments.append(value.toString());
-            standardAction->setAction(std::bind(static_cast<bool(*)(const QString&,const QStringList&)>(&QProcess::startDetached), command, arguments));
+            standardAction->setAction([command, arguments](){ Core::Launcher::startDetached(command, arguments); });
             standardActionVector.push_back(standardAction);
         }
         standardItem->setActions(std::move(standardActionVector));
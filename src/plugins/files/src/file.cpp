@@ -81,6 +81,38 @@ vector<shared_ptr<Core::Action>> Files::File::actions() {
 
 
 
+/** ***************************************************************************/
+size_t Files::File::actionCount() {
+    return 4;
+}
+
+
+
+/** ***************************************************************************/
+QString Files::File::actionText(size_t i) {
+    switch (i) {
+    case 0: return OpenFileAction(this).text();
+    case 1: return RevealFileAction(this).text();
+    case 2: return CopyFileAction(this).text();
+    case 3: return CopyPathAction(this).text();
+    default: return QString();
+    }
+}
+
+
+
+/** ***************************************************************************/
+void Files::File::activateAction(size_t i) {
+    switch (i) {
+    case 0: OpenFileAction(this).activate(); break;
+    case 1: RevealFileAction(this).activate(); break;
+    case 2: CopyFileAction(this).activate(); break;
+    case 3: CopyPathAction(this).activate(); break;
+    }
+}
+
+
+
 /** ***************************************************************************/
 vector<Core::Indexable::WeightedKeyword> Files::File::indexKeywords() const {
     std::vector<Indexable::WeightedKeyword> res;
@@ -47,6 +47,9 @@ public:
     QString iconPath() const override;
     std::vector<Core::Indexable::WeightedKeyword> indexKeywords() const override;
     std::vector<std::shared_ptr<Core::Action>> actions() override;
+    size_t actionCount() override;
+    QString actionText(size_t i) override;
+    void activateAction(size_t i) override;
 
     /*
      * Item specific members
@@ -37,7 +37,7 @@ QString Files::File::OpenFileAction::text() const {
 }
 
 void Files::File::OpenFileAction::activate() {
-    QDesktopServices::openUrl(QUrl::fromLocalFile(file_->path()));
+    Core::Launcher::openUrl(QUrl::fromLocalFile(file_->path()));
 }
 
 /******************************************************************************/
@@ -51,7 +51,7 @@ QString Files::File::RevealFileAction::text() const {
 }
 
 void Files::File::RevealFileAction::activate() {
-    QDesktopServices::openUrl(QUrl::fromLocalFile(QFileInfo(file_->path()).path()));
+    Core::Launcher::openUrl(QUrl::fromLocalFile(QFileInfo(file_->path()).path()));
 }
 
 /******************************************************************************/
@@ -15,7 +15,6 @@
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #pragma once
-#include <QDesktopServices>
 #include <QClipboard>
 #include <QMimeData>
 #include <QApplication>
@@ -23,6 +22,7 @@
 #include <QUrl>
 #include "file.h"
 #include "action.h"
+#include "launcher.h"
 
 namespace Files {
 
@@ -74,9 +74,10 @@ const char* IGNOREFILE          = ".albertignore";
 class Files::FilesPrivate
 {
 public:
-    FilesPrivate(Extension *q) : q(q), abort(false), rerun(false) {}
+    FilesPrivate(Extension *q) : q(q), generation(0), abort(false), rerun(false) {}
 
     Extension *q;
+    uint generation;
 
     QPointer<ConfigWidget> widget;
     QStringList rootDirs;
@@ -155,6 +156,7 @@ void Files::FilesPrivate::finishIndexing() {
     offlineIndex.clear();
     for (const auto &item : index)
         offlineIndex.add(item);
+    ++generation;
 
     // Notification
     qDebug() << qPrintable(QString("[%1] Indexing done (%2 items).").arg(q->Core::Extension::id).arg(index.size()));
@@ -414,6 +416,13 @@ void Files::Extension::handleQuery(Core::Query * query) {
 
 
 
+/** ***************************************************************************/
+uint Files::Extension::indexGeneration() const {
+    return d->generation;
+}
+
+
+
 /** ***************************************************************************/
 void Files::Extension::addDir(const QString &dirPath) {
     QFileInfo fileInfo(dirPath);
@@ -45,6 +45,7 @@ public:
     QString name() const override { return "Files"; }
     QWidget *widget(QWidget *parent = nullptr) override;
     void handleQuery(Core::Query * query) override;
+    uint indexGeneration() const override;
 
     /*
      * Extension specific members
@@ -21,14 +21,12 @@
 #include <QtConcurrent>
 #include <QComboBox>
 #include <QDebug>
-#include <QDesktopServices>
 #include <QDir>
 #include <QFile>
 #include <QFileInfo>
 #include <QFileSystemWatcher>
 #include <QFutureWatcher>
 #include <QPointer>
-#include <QProcess>
 #include <QSettings>
 #include <QSqlDatabase>
 #include <QSqlDriver>
@@ -43,9 +41,10 @@
 #include "configwidget.h"
 #include "extension.h"
 #include "item.h"
+#include "launcher.h"
 #include "offlineindex.h"
+#include "indexable.h"
 #include "standardaction.h"
-#include "standardindexitem.h"
 #include "query.h"
 #include "xdgiconlookup.h"
 using std::pair;
@@ -60,6 +59,93 @@ const bool    DEF_FUZZY   = false;
 const QString CFG_USE_FIREFOX   = "openWithFirefox";
 const bool    DEF_USE_FIREFOX   = false;
 const uint    UPDATE_DELAY = 60000;
+
+/** ***************************************************************************/
+/**
+ * A bookmark. The actions are run directly on activation, action objects are
+ * only built if asked for.
+ */
+class Bookmark final : public Item, public Indexable
+{
+public:
+
+    Bookmark(const QString &id, const QString &name, const QString &url, const QString &iconPath,
+             const QString &firefoxExecutable, bool openWithFirefox)
+        : id_(id), name_(name), url_(url), iconPath_(iconPath),
+          firefoxExecutable_(firefoxExecutable), openWithFirefox_(openWithFirefox) {}
+
+    QString id() const override { return id_; }
+    QString text() const override { return name_; }
+    QString subtext() const override { return url_; }
+    QString iconPath() const override { return iconPath_; }
+    vector<Indexable::WeightedKeyword> indexKeywords() const override { return indexKeywords_; }
+
+    void setIndexKeywords(vector<Indexable::WeightedKeyword> &&keywords) { indexKeywords_ = std::move(keywords); }
+
+    vector<shared_ptr<Action>> actions() override {
+        vector<shared_ptr<Action>> actions;
+        // Actions may outlive the bookmark, e.g. after a reindex
+        QString url = url_;
+        QString firefoxExecutable = firefoxExecutable_;
+        for (size_t i = 0; i < actionCount(); ++i) {
+            Kind kind = this->kind(i);
+            actions.push_back(std::make_shared<StandardAction>(actionText(i), [kind, url, firefoxExecutable](){
+                activate(kind, url, firefoxExecutable);
+            }));
+        }
+        return actions;
+    }
+
+    size_t actionCount() override {
+        return 3;
+    }
+
+    QString actionText(size_t i) override {
+        switch (kind(i)) {
+        case Kind::OpenDefault: return "Open in default browser";
+        case Kind::OpenFirefox: return "Open in firefox";
+        case Kind::CopyUrl: return "Copy url to clipboard";
+        default: return QString();
+        }
+    }
+
+    void activateAction(size_t i) override {
+        activate(kind(i), url_, firefoxExecutable_);
+    }
+
+private:
+
+    enum class Kind { OpenDefault, OpenFirefox, CopyUrl, None };
+
+    static void activate(Kind kind, const QString &url, const QString &firefoxExecutable) {
+        switch (kind) {
+        case Kind::OpenDefault: Core::Launcher::openUrl(QUrl(url)); break;
+        case Kind::OpenFirefox: Core::Launcher::startDetached(firefoxExecutable, {url}); break;
+        case Kind::CopyUrl: QApplication::clipboard()->setText(url); break;
+        default: break;
+        }
+    }
+
+    // The order of the browser actions depends on the settings
+    Kind kind(size_t i) const {
+        switch (i) {
+        case 0: return openWithFirefox_ ? Kind::OpenFirefox : Kind::OpenDefault;
+        case 1: return openWithFirefox_ ? Kind::OpenDefault : Kind::OpenFirefox;
+        case 2: return Kind::CopyUrl;
+        default: return Kind::None;
+        }
+    }
+
+    QString id_;
+    QString name_;
+    QString url_;
+    QString iconPath_;
+    QString firefoxExecutable_;
+    bool openWithFirefox_;
+    vector<Indexable::WeightedKeyword> indexKeywords_;
+
+};
+
 }
 
 
@@ -71,9 +157,10 @@ const uint    UPDATE_DELAY = 60000;
 class FirefoxBookmarks::FirefoxBookmarksPrivate
 {
 public:
-    FirefoxBookmarksPrivate(Extension *q) : q(q) {}
+    FirefoxBookmarksPrivate(Extension *q) : q(q), generation(0) {}
 
     Extension *q;
+    uint generation;
 
     bool openWithFirefox;
     QPointer<ConfigWidget> widget;
@@ -82,14 +169,14 @@ public:
     QString currentProfileId;
     QFileSystemWatcher databaseWatcher;
 
-    vector<shared_ptr<Core::StandardIndexItem>> index;
+    vector<shared_ptr<Bookmark>> index;
     Core::OfflineIndex offlineIndex;
 
     QTimer updateDelayTimer;
     void startIndexing();
     void finishIndexing();
-    QFutureWatcher<vector<shared_ptr<Core::StandardIndexItem>>> futureWatcher;
-    std::vector<std::shared_ptr<Core::StandardIndexItem>> indexFirefoxBookmarks() const;
+    QFutureWatcher<vector<shared_ptr<Bookmark>>> futureWatcher;
+    vector<shared_ptr<Bookmark>> indexFirefoxBookmarks() const;
 };
 
 
@@ -102,7 +189,7 @@ void FirefoxBookmarks::FirefoxBookmarksPrivate::startIndexing() {
 
     // Run finishIndexing when the indexing thread finished
     futureWatcher.disconnect();
-    QObject::connect(&futureWatcher, &QFutureWatcher<vector<shared_ptr<Core::StandardIndexItem>>>::finished,
+    QObject::connect(&futureWatcher, &QFutureWatcher<vector<shared_ptr<Bookmark>>>::finished,
                      std::bind(&FirefoxBookmarksPrivate::finishIndexing, this));
 
     // Run the indexer thread
@@ -124,6 +211,7 @@ void FirefoxBookmarks::FirefoxBookmarksPrivate::finishIndexing() {
     offlineIndex.clear();
     for (const auto &item : index)
         offlineIndex.add(item);
+    ++generation;
 
     // Notification
     qDebug() <<  qPrintable(QString("[%1] Indexing done (%2 items).").arg(q->Core::Extension::id).arg(index.size()));
@@ -133,18 +221,18 @@ void FirefoxBookmarks::FirefoxBookmarksPrivate::finishIndexing() {
 
 
 /** ***************************************************************************/
-vector<shared_ptr<Core::StandardIndexItem>>
+vector<shared_ptr<Bookmark>>
 FirefoxBookmarks::FirefoxBookmarksPrivate::indexFirefoxBookmarks() const {
 
     QSqlDatabase database = QSqlDatabase::database(q->Core::Extension::id);
 
     if (!database.open()) {
         qWarning() << qPrintable(QString("[%1] Could not open database: %2").arg(q->Core::Extension::id, database.databaseName()));
-        return vector<shared_ptr<Core::StandardIndexItem>>();
+        return vector<shared_ptr<Bookmark>>();
     }
 
     // Build a new index
-    vector<shared_ptr<StandardIndexItem>> bookmarks;
+    vector<shared_ptr<Bookmark>> bookmarks;
 
     QSqlQuery result(database);
 
@@ -154,7 +242,7 @@ FirefoxBookmarks::FirefoxBookmarksPrivate::indexFirefoxBookmarks() const {
                       "JOIN moz_places AS p  ON b1.fk = p.id " // attach title string and url
                       "WHERE b1.type = 1 AND p.title IS NOT NULL") ) { // filter bookmarks with nonempty title string
         qWarning() << qPrintable(QString("[%1] Querying bookmarks failed: %2").arg(q->Core::Extension::id, result.lastError().text()));
-        return vector<shared_ptr<Core::StandardIndexItem>>();
+        return vector<shared_ptr<Bookmark>>();
     }
 
     // Find an appropriate icon
@@ -172,10 +260,12 @@ FirefoxBookmarks::FirefoxBookmarksPrivate::indexFirefoxBookmarks() const {
         QString urlstr = result.value(2).toString();
 
         // Create item
-        shared_ptr<StandardIndexItem> ssii  = std::make_shared<StandardIndexItem>(result.value(0).toString());
-        ssii->setText(result.value(1).toString());
-        ssii->setSubtext(urlstr);
-        ssii->setIconPath(icon);
+        shared_ptr<Bookmark> ssii  = std::make_shared<Bookmark>(result.value(0).toString(),
+                                                                result.value(1).toString(),
+                                                                urlstr,
+                                                                icon,
+                                                                firefoxExecutable,
+                                                                openWithFirefox);
 
         // Add severeal secondary index keywords
         vector<Indexable::WeightedKeyword> weightedKeywords;
@@ -186,37 +276,6 @@ FirefoxBookmarks::FirefoxBookmarksPrivate::indexFirefoxBookmarks() const {
         weightedKeywords.emplace_back(result.value(2).toString(), USHRT_MAX/4); // parent dirname
         ssii->setIndexKeywords(std::move(weightedKeywords));
 
-        // Add actions
-        vector<shared_ptr<Action>> actions;
-
-        shared_ptr<StandardAction> actionDefault = std::make_shared<StandardAction>();
-        actionDefault->setText("Open in default browser");
-        actionDefault->setAction([urlstr](){
-            QDesktopServices::openUrl(QUrl(urlstr));
-        });
-
-        shared_ptr<StandardAction> actionFirefox = std::make_shared<StandardAction>();
-        actionFirefox->setText("Open in firefox");
-        actionFirefox->setAction([urlstr, this](){
-            QProcess::startDetached(firefoxExecutable, {urlstr});
-        });
-
-        shared_ptr<StandardAction> action = std::make_shared<StandardAction>();
-        action->setText("Copy url to clipboard");
-        action->setAction([urlstr](){ QApplication::clipboard()->setText(urlstr); });
-
-        // Set the order of the actions
-        if ( openWithFirefox )  {
-            actions.push_back(std::move(actionFirefox));
-            actions.push_back(std::move(actionDefault));
-        } else {
-            actions.push_back(std::move(actionDefault));
-            actions.push_back(std::move(actionFirefox));
-        }
-        actions.push_back(std::move(action));
-
-        ssii->setActions(std::move(actions));
-
         bookmarks.push_back(std::move(ssii));
     }
 
@@ -385,13 +444,20 @@ void FirefoxBookmarks::Extension::handleQuery(Core::Query *query) {
     // Add results to query.
     vector<pair<shared_ptr<Core::Item>,short>> results;
     for (const shared_ptr<Core::Indexable> &item : indexables)
-        results.emplace_back(std::static_pointer_cast<Core::StandardIndexItem>(item), 0);
+        results.emplace_back(std::static_pointer_cast<Bookmark>(item), 0);
 
     query->addMatches(results.begin(), results.end());
 }
 
 
 
+/** ***************************************************************************/
+uint FirefoxBookmarks::Extension::indexGeneration() const {
+    return d->generation;
+}
+
+
+
 /** ***************************************************************************/
 void FirefoxBookmarks::Extension::setProfile(const QString& profile) {
 
@@ -441,6 +507,7 @@ void FirefoxBookmarks::Extension::setProfile(const QString& profile) {
 /** ***************************************************************************/
 void FirefoxBookmarks::Extension::changeFuzzyness(bool fuzzy) {
     d->offlineIndex.setFuzzy(fuzzy);
+    ++d->generation;
     QSettings(qApp->applicationName()).setValue(QString("%1/%2").arg(Core::Extension::id, CFG_FUZZY), fuzzy);
 }
 
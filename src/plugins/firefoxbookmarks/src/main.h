@@ -49,6 +49,7 @@ public:
     QString name() const override { return "Firefox bookmarks"; }
     QWidget *widget(QWidget *parent = nullptr) override;
     void handleQuery(Core::Query * query) override;
+    uint indexGeneration() const override;
 
     /*
      * Extension specific members
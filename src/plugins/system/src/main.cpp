@@ -16,10 +16,10 @@
 
 #include <QDebug>
 #include <QPointer>
-#include <QProcess>
 #include <QSettings>
 #include <vector>
 #include "configwidget.h"
+#include "launcher.h"
 #include "main.h"
 #include "standardaction.h"
 #include "standarditem.h"
@@ -253,7 +253,7 @@ void System::Extension::handleQuery(Core::Query * query) {
             std::shared_ptr<Core::StandardAction> action = std::make_shared<Core::StandardAction>();
             action->setText(itemDescriptions[i]);
             action->setAction([=](){
-                QProcess::startDetached(cmd);
+                Core::Launcher::startDetached(cmd);
             });
 
             item->setActions({action});
@@ -19,13 +19,13 @@
 #include <QFileSystemWatcher>
 #include <QDirIterator>
 #include <QPointer>
-#include <QProcess>
 #include <QStringList>
 #include <algorithm>
 #include <set>
 #include "main.h"
 #include "xdgiconlookup.h"
 #include "configwidget.h"
+#include "launcher.h"
 #include "query.h"
 #include "standarditem.h"
 #include "standardaction.h"
@@ -101,8 +101,6 @@ void Terminal::Extension::teardownSession() {
 /** ***************************************************************************/
 void Terminal::Extension::handleQuery(Core::Query * query) {
 
-    vector<pair<shared_ptr<Core::Item>,short>> results;
-
     // Drop the query
     QString actualQuery = query->searchTerm().mid(1);
 
@@ -118,13 +116,20 @@ void Terminal::Extension::handleQuery(Core::Query * query) {
     QString program;
      while (it != d->index.end() && it->startsWith(potentialProgram)){
         program = *it;
+
+        // Do not build items that can not make it into the results
+        if ( !query->isWanted(program) ) {
+            ++it;
+            continue;
+        }
+
         QString commandlineString = QString("%1 %2").arg(program, argsString);
 
         std::vector<shared_ptr<Action>> actions;
         shared_ptr<StandardAction> action = std::make_shared<StandardAction>();
         action->setText("Execute in background");
         action->setAction([program, args](){
-            QProcess::startDetached(program, args);
+            Core::Launcher::startDetached(program, args);
         });
         actions.push_back(std::move(action));
 
@@ -136,7 +141,7 @@ void Terminal::Extension::handleQuery(Core::Query * query) {
         action->setAction([cmddline](){
             QStringList args = cmddline;
             QString program = args.takeFirst();
-            QProcess::startDetached(program, args);
+            Core::Launcher::startDetached(program, args);
         });
         actions.push_back(std::move(action));
 
@@ -149,7 +154,7 @@ void Terminal::Extension::handleQuery(Core::Query * query) {
         action->setAction([cmddline](){
             QStringList args = cmddline;
             QString program = args.takeFirst();
-            QProcess::startDetached(program, args);
+            Core::Launcher::startDetached(program, args);
         });
         actions.push_back(std::move(action));
 
@@ -159,12 +164,10 @@ void Terminal::Extension::handleQuery(Core::Query * query) {
         item->setIconPath(d->iconPath);
         item->setActions(std::move(actions));
 
-        results.emplace_back(item, 0);
+        // Add the match right away, it raises the bar for the next ones
+        query->addMatch(item, 0);
         ++it;
     }
-
-    // Add results to query
-    query->addMatches(results.begin(), results.end());
 }
 
 
@@ -22,6 +22,7 @@
 #include <QDomDocument>
 #include <QDomElement>
 #include <QFile>
+#include "launcher.h"
 #include "standardaction.h"
 using Core::StandardAction;
 
@@ -102,20 +103,20 @@ VirtualBox::VMItem *VirtualBox::VM::produceItem() const {
         actions.push_back(std::shared_ptr<StandardAction>( new StandardAction("Controls are disabled", [](){}) ));
     } else if (state_ == "poweroff" || state_ == "aborted") {
         mainAction = VMItem::VM_START;
-        actions.push_back(std::shared_ptr<StandardAction>( new StandardAction("Start", [startCmd](){ QProcess::startDetached(startCmd); }) ));
+        actions.push_back(std::shared_ptr<StandardAction>( new StandardAction("Start", [startCmd](){ Core::Launcher::startDetached(startCmd); }) ));
     } else if (state_ == "saved") {
         mainAction = VMItem::VM_START;
-        actions.push_back(std::shared_ptr<StandardAction>( new StandardAction("Start", [startCmd](){ QProcess::startDetached(startCmd); }) ));
+        actions.push_back(std::shared_ptr<StandardAction>( new StandardAction("Start", [startCmd](){ Core::Launcher::startDetached(startCmd); }) ));
     } else if (state_ == "running") {
         mainAction = VMItem::VM_PAUSE;
-        actions.push_back(std::shared_ptr<StandardAction>( new StandardAction("Pause", [pauseCmd](){ QProcess::startDetached(pauseCmd); }) ));
-        actions.push_back(std::shared_ptr<StandardAction>( new StandardAction("Save State", [saveCmd](){ QProcess::startDetached(saveCmd); }) ));
-        actions.push_back(std::shared_ptr<StandardAction>( new StandardAction("Stop", [stopCmd](){ QProcess::startDetached(stopCmd); }) ));
+        actions.push_back(std::shared_ptr<StandardAction>( new StandardAction("Pause", [pauseCmd](){ Core::Launcher::startDetached(pauseCmd); }) ));
+        actions.push_back(std::shared_ptr<StandardAction>( new StandardAction("Save State", [saveCmd](){ Core::Launcher::startDetached(saveCmd); }) ));
+        actions.push_back(std::shared_ptr<StandardAction>( new StandardAction("Stop", [stopCmd](){ Core::Launcher::startDetached(stopCmd); }) ));
     } else if (state_ == "paused") {
         mainAction = VMItem::VM_RESUME;
-        actions.push_back(std::shared_ptr<StandardAction>( new StandardAction("Resume", [resumeCmd](){ QProcess::startDetached(resumeCmd); }) ));
-        actions.push_back(std::shared_ptr<StandardAction>( new StandardAction("Save State", [saveCmd](){ QProcess::startDetached(saveCmd); }) ));
-        actions.push_back(std::shared_ptr<StandardAction>( new StandardAction("Reset", [resetCmd](){ QProcess::startDetached(resetCmd); }) ));
+        actions.push_back(std::shared_ptr<StandardAction>( new StandardAction("Resume", [resumeCmd](){ Core::Launcher::startDetached(resumeCmd); }) ));
+        actions.push_back(std::shared_ptr<StandardAction>( new StandardAction("Save State", [saveCmd](){ Core::Launcher::startDetached(saveCmd); }) ));
+        actions.push_back(std::shared_ptr<StandardAction>( new StandardAction("Reset", [resetCmd](){ Core::Launcher::startDetached(resetCmd); }) ));
     }
 
     return new VMItem(name_, uuid_, mainAction, actions, state_);
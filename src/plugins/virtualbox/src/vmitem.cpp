@@ -16,7 +16,7 @@
 
 #include "vmitem.h"
 
-#include <QProcess>
+#include "launcher.h"
 
 /** ***************************************************************************/
 QString VirtualBox::VMItem::iconPath_;
@@ -71,6 +71,6 @@ void VirtualBox::VMItem::activate(Action::ExecutionFlags *) {
         break;
     }
     if (!executionCommand.isEmpty())
-        QProcess::startDetached(executionCommand.arg(uuid_));
+        Core::Launcher::startDetached(executionCommand.arg(uuid_));
 }
 */
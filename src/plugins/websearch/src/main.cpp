@@ -16,7 +16,6 @@
 
 #include <QByteArray>
 #include <QDebug>
-#include <QDesktopServices>
 #include <QDir>
 #include <QFile>
 #include <QIcon>
@@ -31,6 +30,7 @@
 #include "main.h"
 #include "configwidget.h"
 #include "item.h"
+#include "launcher.h"
 #include "standarditem.h"
 #include "standardaction.h"
 #include "query.h"
@@ -61,7 +61,7 @@ shared_ptr<Core::Item> buildWebsearchItem(const SearchEngine &se, const QString
 
     std::shared_ptr<StandardAction> action = std::make_shared<StandardAction>();
     action->setText(desc);
-    action->setAction([=](){ QDesktopServices::openUrl(url); });
+    action->setAction([=](){ Core::Launcher::openUrl(url); });
 
     std::shared_ptr<StandardItem> item = std::make_shared<StandardItem>(se.name);
     item->setText(se.name);